@@ -0,0 +1,93 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "scanner.h"
+#include "tokens.h"
+
+/**
+ * @brief Checks lexParallel against the serial scanner, run directly: slorp_lexcheck [seeds]
+ *
+ * Every seed generates a source just above PARALLEL_LEX_MIN_BYTES out of random pieces, with
+ * multi-line strings and comments holding quotes so cuts land inside them, error characters,
+ * and every fifth seed an unterminated string. Each source is tokenized on 2, 4, 8 and 16 threads
+ * and compared token by token, type, position, length and line, with what scanToken gives.
+ * Exits with 1 when any run mismatches.
+ */
+
+static const char *pieces[] = {
+    "var", " ", "x1", "=", "12.5", ";", "\n", "\"str\"", "\"multi\nline\nstring\"", "// comment \"q\n",
+    "print", "(", ")", "{", "}", "!=", "==", "<=", "@", "\t", "and", "\n\n", "\"a\nb\"", "[", "]", ":",
+};
+
+#define PIECE_COUNT (sizeof(pieces) / sizeof(pieces[0]))
+
+static char *generateSource(int seed)
+{
+    srand(seed);
+    size_t length = PARALLEL_LEX_MIN_BYTES + 1024 + rand() % (PARALLEL_LEX_MIN_BYTES / 4);
+    char *source = malloc(length + 64);
+    size_t at = 0;
+    while (at < length)
+    {
+        const char *piece = pieces[rand() % PIECE_COUNT];
+        if (seed % 5 == 0 && rand() % 20000 == 0)
+            piece = "\"open string\n";
+        size_t pieceLength = strlen(piece);
+        memcpy(source + at, piece, pieceLength);
+        at += pieceLength;
+    }
+    source[at] = '\0';
+    return source;
+}
+
+// Whether the parallel tokens of `source` on `jobs` threads are the serial ones
+static bool checkSource(const char *source, int seed, int jobs)
+{
+    TokenBuffer buffer;
+    if (!lexParallel(&buffer, source, jobs))
+    {
+        printf("seed %d jobs %d: not tokenized in parallel\n", seed, jobs);
+        return false;
+    }
+
+    Scanner scanner;
+    initScanner(&scanner, source);
+    bool same = true;
+    for (size_t i = 0;; i++)
+    {
+        Token serial = scanToken(&scanner);
+        Token parallel = nextBufferedToken(&buffer);
+        if (serial.type != parallel.type || serial.start != parallel.start || serial.length != parallel.length ||
+            serial.line != parallel.line)
+        {
+            printf("seed %d jobs %d token %zu: type %d/%d line %d/%d\n", seed, jobs, i, serial.type,
+                   parallel.type, serial.line, parallel.line);
+            same = false;
+            break;
+        }
+        if (serial.type == TOKEN_EOF)
+            break;
+    }
+    freeTokenBuffer(&buffer);
+    return same;
+}
+
+int main(int argc, const char *argv[])
+{
+    int seeds = argc > 1 ? atoi(argv[1]) : 20;
+    int runs = 0, mismatches = 0;
+    for (int seed = 0; seed < seeds; seed++)
+    {
+        char *source = generateSource(seed);
+        for (int jobs = 2; jobs <= 16; jobs *= 2)
+        {
+            runs++;
+            if (!checkSource(source, seed, jobs))
+                mismatches++;
+        }
+        free(source);
+    }
+    printf("%d runs, %d mismatches\n", runs, mismatches);
+    return mismatches > 0;
+}
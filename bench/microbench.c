@@ -0,0 +1,498 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "array.h"
+#include "common.h"
+#include "compiler.h"
+#include "memory.h"
+#include "number.h"
+#include "object.h"
+#include "table.h"
+#include "value.h"
+#include "vm.h"
+
+/**
+ * @brief Microbenchmarks for the interpreters core data structures
+ *
+ * Measures Table set/get/delete throughput at different key counts and load factors,
+ * tombstone churn, copyString interning hits and misses, valuesEqual, number formatting
+ * and parsing next to the C library, the array kernels next to plain loops, and columnar runs
+ * next to running a chunk per row.
+ * Probe lengths are computed by replaying the tables linear probing over its entries,
+ * so table.c itself needs no instrumentation.
+ */
+
+#define HISTOGRAM_BUCKETS 8
+#define KEY_BUFFER_SIZE 32
+
+static VM vm; // the benchmarks share one interpreter
+
+static const char *bucketLabels[HISTOGRAM_BUCKETS] = {"1", "2", "3", "4", "5-8", "9-16", "17-64", "65+"};
+
+typedef struct
+{
+    long buckets[HISTOGRAM_BUCKETS];
+    long samples;
+    long total;
+    int max;
+} ProbeHistogram;
+
+static double nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int bucketFor(int probes)
+{
+    if (probes <= 4)
+        return probes - 1;
+    if (probes <= 8)
+        return 4;
+    if (probes <= 16)
+        return 5;
+    if (probes <= 64)
+        return 6;
+    return 7;
+}
+
+static void recordProbe(ProbeHistogram *histogram, int probes)
+{
+    histogram->buckets[bucketFor(probes)]++;
+    histogram->samples++;
+    histogram->total += probes;
+    if (probes > histogram->max)
+        histogram->max = probes;
+}
+
+// Number of slots findEntry() visits to find `key`, mirrors its linear probing
+static int probeLength(Table *table, ObjString *key)
+{
+    uint32_t index = key->hash % table->capacity;
+    int probes = 1;
+    for (;;)
+    {
+        Entry *entry = &table->entries[index];
+        if (entry->key == key)
+            return probes;
+        if (entry->key == NULL && IS_NIL(entry->value))
+            return probes; // miss, ended on an empty slot
+
+        index = (index + 1) % table->capacity;
+        probes++;
+    }
+}
+
+static void printHistogram(const char *title, ProbeHistogram *histogram)
+{
+    printf("    %s probes: mean %.2f, max %d\n      ", title,
+           histogram->samples ? (double)histogram->total / histogram->samples : 0.0,
+           histogram->max);
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+    {
+        double share = histogram->samples ? 100.0 * histogram->buckets[i] / histogram->samples : 0.0;
+        printf("%6s:%5.1f%% ", bucketLabels[i], share);
+    }
+    printf("\n");
+}
+
+static int tombstoneCount(Table *table)
+{
+    int tombstones = 0;
+    for (int i = 0; i < table->capacity; i++)
+    {
+        Entry *entry = &table->entries[i];
+        if (entry->key == NULL && !IS_NIL(entry->value))
+            tombstones++;
+    }
+    return tombstones;
+}
+
+static ObjString **makeKeys(const char *prefix, int count)
+{
+    ObjString **keys = malloc(sizeof(ObjString *) * count);
+    char buffer[KEY_BUFFER_SIZE];
+    for (int i = 0; i < count; i++)
+    {
+        int length = snprintf(buffer, sizeof(buffer), "%s%d", prefix, i);
+        keys[i] = copyString(&vm, buffer, length);
+    }
+    return keys;
+}
+
+static void report(const char *name, long operations, double elapsedNs)
+{
+    printf("  %-28s %10.2f ns/op %10.2f Mops/s\n", name,
+           elapsedNs / operations, operations / elapsedNs * 1e3);
+}
+
+/**
+ * @brief Fills a table with `count` keys then times set/get/delete and samples probe lengths
+ * The table grows at 75% load, so the load factor follows from count
+ */
+static void benchTable(int count, int rounds)
+{
+    static int generation = 0;
+    char prefix[KEY_BUFFER_SIZE];
+    snprintf(prefix, sizeof(prefix), "t%d_", generation++);
+    ObjString **keys = makeKeys(prefix, count);
+    ObjString **missing = makeKeys("missing_", count);
+
+    Table table;
+    initTable(&table);
+
+    double start = nowNs();
+    for (int i = 0; i < count; i++)
+        tableSet(&vm, &table, keys[i], NUMBER_VAL(i));
+    double insertNs = nowNs() - start;
+
+    printf("\n  keys %d, capacity %d, load %.3f\n", count, table.capacity,
+           (double)table.count / table.capacity);
+    report("tableSet (insert)", count, insertNs);
+
+    start = nowNs();
+    for (int r = 0; r < rounds; r++)
+        for (int i = 0; i < count; i++)
+            tableSet(&vm, &table, keys[i], NUMBER_VAL(r));
+    report("tableSet (overwrite)", (long)count * rounds, nowNs() - start);
+
+    Value value;
+    double sink = 0.0;
+    start = nowNs();
+    for (int r = 0; r < rounds; r++)
+        for (int i = 0; i < count; i++)
+            if (tableGet(&vm, &table, keys[i], &value))
+                sink += AS_NUMBER(value);
+    report("tableGet (hit)", (long)count * rounds, nowNs() - start);
+
+    start = nowNs();
+    for (int r = 0; r < rounds; r++)
+        for (int i = 0; i < count; i++)
+            if (tableGet(&vm, &table, missing[i], &value))
+                sink += AS_NUMBER(value);
+    report("tableGet (miss)", (long)count * rounds, nowNs() - start);
+
+    ProbeHistogram hits = {0};
+    ProbeHistogram misses = {0};
+    for (int i = 0; i < count; i++)
+    {
+        recordProbe(&hits, probeLength(&table, keys[i]));
+        recordProbe(&misses, probeLength(&table, missing[i]));
+    }
+    printHistogram("hit ", &hits);
+    printHistogram("miss", &misses);
+
+    start = nowNs();
+    for (int i = 0; i < count; i++)
+        tableDelete(&vm, &table, keys[i]);
+    report("tableDelete", count, nowNs() - start);
+
+    if (sink == 0.5)
+        printf("%f\n", sink); // keeps the lookups observable to the optimizer
+
+    freeTable(&vm, &table);
+    free(keys);
+    free(missing);
+}
+
+/**
+ * @brief Steady-state churn: delete one key and insert a fresh one, the live count stays fixed
+ * Tombstones are counted as load by tableSet, so this shows how often churn forces a rebuild
+ */
+static void benchTombstones(int live, int operations)
+{
+    ObjString **keys = makeKeys("churn_", live + operations);
+
+    Table table;
+    initTable(&table);
+    for (int i = 0; i < live; i++)
+        tableSet(&vm, &table, keys[i], NUMBER_VAL(i));
+
+    int capacityBefore = table.capacity;
+    double start = nowNs();
+    for (int i = 0; i < operations; i++)
+    {
+        tableDelete(&vm, &table, keys[i]);
+        tableSet(&vm, &table, keys[live + i], NUMBER_VAL(i));
+    }
+    double elapsed = nowNs() - start;
+
+    printf("\n  live %d, %d delete+insert pairs, capacity %d -> %d, tombstones %d\n",
+           live, operations, capacityBefore, table.capacity, tombstoneCount(&table));
+    report("delete+insert", operations, elapsed);
+
+    ProbeHistogram histogram = {0};
+    for (int i = operations; i < live + operations; i++)
+        recordProbe(&histogram, probeLength(&table, keys[i]));
+    printHistogram("live", &histogram);
+
+    freeTable(&vm, &table);
+    free(keys);
+}
+
+/**
+ * @brief copyString at a given hit rate, a hit returns the interned string, a miss allocates one
+ */
+static void benchInterning(int operations, int hitPercent)
+{
+    static int generation = 0;
+    const int poolSize = 1024;
+    char buffer[KEY_BUFFER_SIZE];
+
+    char prefix[KEY_BUFFER_SIZE];
+    snprintf(prefix, sizeof(prefix), "pool%d_", generation);
+    free(makeKeys(prefix, poolSize)); // Interned, now every lookup of them is a hit
+
+    int hits = 0;
+    double start = nowNs();
+    for (int i = 0; i < operations; i++)
+    {
+        int length;
+        if (i % 100 < hitPercent)
+        {
+            length = snprintf(buffer, sizeof(buffer), "%s%d", prefix, i % poolSize);
+            hits++;
+        }
+        else
+        {
+            length = snprintf(buffer, sizeof(buffer), "new%d_%d", generation, i);
+        }
+        copyString(&vm, buffer, length);
+    }
+    double elapsed = nowNs() - start;
+    generation++;
+
+    char name[64];
+    snprintf(name, sizeof(name), "copyString %3d%% hits", hitPercent);
+    report(name, operations, elapsed);
+    printf("    hit rate %.1f%%, intern table %d/%d\n", 100.0 * hits / operations,
+           vm.strings.count, vm.strings.capacity);
+}
+
+static void benchValuesEqual(const char *name, Value a, Value b, int operations)
+{
+    int equal = 0;
+    double start = nowNs();
+    for (int i = 0; i < operations; i++)
+    {
+        equal += valuesEqual(a, b);
+        a = (i & 1) ? a : b; // defeat hoisting the call out of the loop
+    }
+    report(name, operations, nowNs() - start);
+    if (equal < 0)
+        printf("%d\n", equal);
+}
+
+static void benchFormat(int operations)
+{
+    char buffer[NUMBER_BUFFER_SIZE];
+    // Mix of short literals, full-precision results and huge/tiny magnitudes
+    const double values[] = {1.5, 42, 0.1, 1.0 / 3.0, 6735920000.0, 2.718281828459045, 1e300, 5e-324};
+    const int valueCount = sizeof(values) / sizeof(values[0]);
+    size_t sink = 0;
+
+    double start = nowNs();
+    for (int i = 0; i < operations; i++)
+        sink += formatNumber(values[i % valueCount] * (1 + (i & 1)), buffer);
+    report("formatNumber", operations, nowNs() - start);
+
+    start = nowNs();
+    for (int i = 0; i < operations; i++)
+        sink += snprintf(buffer, sizeof(buffer), "%g", values[i % valueCount] * (1 + (i & 1)));
+    report("snprintf %g", operations, nowNs() - start);
+
+    start = nowNs();
+    for (int i = 0; i < operations; i++)
+        sink += snprintf(buffer, sizeof(buffer), "%.17g", values[i % valueCount] * (1 + (i & 1)));
+    report("snprintf %.17g", operations, nowNs() - start);
+
+    if (sink == 1)
+        printf("%zu\n", sink);
+}
+
+static void benchParse(int operations)
+{
+    const char *literals[] = {"1", "42", "3.14159", "0.1", "1000000", "2.718281828459045", "12345.678"};
+    const int literalCount = sizeof(literals) / sizeof(literals[0]);
+    int lengths[sizeof(literals) / sizeof(literals[0])];
+    for (int i = 0; i < literalCount; i++)
+        lengths[i] = (int)strlen(literals[i]);
+    double sink = 0.0;
+
+    double start = nowNs();
+    for (int i = 0; i < operations; i++)
+        sink += parseNumber(literals[i % literalCount], lengths[i % literalCount]);
+    report("parseNumber", operations, nowNs() - start);
+
+    start = nowNs();
+    for (int i = 0; i < operations; i++)
+        sink += strtod(literals[i % literalCount], NULL);
+    report("strtod", operations, nowNs() - start);
+
+    if (sink == 0.5)
+        printf("%f\n", sink);
+}
+
+// Per element, `count` doubles per call, the plain loops are what the kernels replace
+static void benchArrayKernels(int count, int rounds)
+{
+    double *a = malloc(sizeof(double) * count);
+    double *b = malloc(sizeof(double) * count);
+    double *result = malloc(sizeof(double) * count);
+    for (int i = 0; i < count; i++)
+    {
+        a[i] = i * 0.5;
+        b[i] = (count - i) * 0.25;
+    }
+    long elements = (long)count * rounds;
+    double sink = 0.0;
+
+    double start = nowNs();
+    for (int round = 0; round < rounds; round++)
+        sink += sumDoubles(a, count);
+    report("sumDoubles", elements, nowNs() - start);
+
+    start = nowNs();
+    for (int round = 0; round < rounds; round++)
+    {
+        double sum = 0.0;
+        for (int i = 0; i < count; i++)
+            sum += a[i];
+        sink += sum;
+    }
+    report("sum loop", elements, nowNs() - start);
+
+    start = nowNs();
+    for (int round = 0; round < rounds; round++)
+        sink += dotDoubles(a, b, count);
+    report("dotDoubles", elements, nowNs() - start);
+
+    start = nowNs();
+    for (int round = 0; round < rounds; round++)
+        sink += maxDoubles(a, count);
+    report("maxDoubles", elements, nowNs() - start);
+
+    start = nowNs();
+    for (int round = 0; round < rounds; round++)
+    {
+        scaleDoubles(result, a, 1.5, count);
+        sink += result[round % count];
+    }
+    report("scaleDoubles", elements, nowNs() - start);
+
+    if (sink == 0.5)
+        printf("%f\n", sink);
+    free(a);
+    free(b);
+    free(result);
+}
+
+/**
+ * @brief One script over `rows` rows of three input columns, runColumns next to a loop that
+ * binds the inputs and runs the chunk once per row, which is what runColumns falls back to
+ */
+static void benchColumns(int rows)
+{
+    const char *source = "var total = price * qty + fee;\n"
+                         "var result = total - total / 10 + 2;\n";
+    Chunk chunk;
+    initChunk(&chunk);
+    if (!compile(&vm, source, &chunk))
+        return;
+
+    const char *names[] = {"price", "qty", "fee"};
+    InputColumn inputs[3];
+    for (int i = 0; i < 3; i++)
+    {
+        double *values = malloc(sizeof(double) * rows);
+        for (int row = 0; row < rows; row++)
+            values[row] = (row % 97) * (i + 0.5);
+        inputs[i].name = names[i];
+        inputs[i].values = values;
+    }
+    Value *results = malloc(sizeof(Value) * rows);
+
+    int failedRow;
+    double start = nowNs();
+    runColumns(&vm, &chunk, inputs, 3, rows, "result", results, &failedRow);
+    report("runColumns", rows, nowNs() - start);
+
+    ObjString *keys[3];
+    for (int i = 0; i < 3; i++)
+        keys[i] = copyString(&vm, names[i], (int)strlen(names[i]));
+    ObjString *result = copyString(&vm, "result", 6);
+    start = nowNs();
+    for (int row = 0; row < rows; row++)
+    {
+        for (int i = 0; i < 3; i++)
+            tableSet(&vm, &vm.globals, keys[i], NUMBER_VAL(inputs[i].values[row]));
+        runChunk(&vm, &chunk);
+        tableGet(&vm, &vm.globals, result, &results[row]);
+    }
+    report("runChunk per row", rows, nowNs() - start);
+
+    for (int i = 0; i < 3; i++)
+        free((double *)inputs[i].values);
+    free(results);
+    freeChunk(&vm, &chunk);
+}
+
+int main(int argc, const char *argv[])
+{
+    int scale = argc > 1 ? atoi(argv[1]) : 1;
+    if (scale < 1)
+        scale = 1;
+
+    initVM(&vm);
+
+    printf("Table\n");
+    const int capacities[] = {1024, 16384, 262144};
+    for (int i = 0; i < 3; i++)
+    {
+        int capacity = capacities[i];
+        int rounds = scale * (1 << 22) / capacity + 1;
+        benchTable(capacity * 3 / 8 + 1, rounds); // just past a resize, lowest load
+        benchTable(capacity * 9 / 16, rounds);    // half way
+        benchTable(capacity * 3 / 4 - 1, rounds); // just before a resize, highest load
+    }
+
+    printf("\nTombstones\n");
+    benchTombstones(1000, scale * 100000);
+    benchTombstones(100000, scale * 100000);
+
+    printf("\nInterning\n");
+    benchInterning(scale * 200000, 100);
+    benchInterning(scale * 200000, 90);
+    benchInterning(scale * 200000, 50);
+    benchInterning(scale * 200000, 0);
+
+    printf("\nvaluesEqual\n");
+    const int operations = scale * 10000000;
+    ObjString *a = copyString(&vm, "a", 1);
+    ObjString *b = copyString(&vm, "b", 1);
+    benchValuesEqual("numbers", NUMBER_VAL(1), NUMBER_VAL(2), operations);
+    benchValuesEqual("integers", INT_VAL(1), INT_VAL(2), operations);
+    benchValuesEqual("booleans", BOOL_VAL(true), BOOL_VAL(false), operations);
+    benchValuesEqual("nil", NIL_VAL, NIL_VAL, operations);
+    benchValuesEqual("strings", OBJ_VAL(a), OBJ_VAL(b), operations);
+    benchValuesEqual("mixed types", NUMBER_VAL(1), OBJ_VAL(a), operations);
+
+    printf("\nNumbers\n");
+    benchFormat(scale * 2000000);
+    benchParse(scale * 2000000);
+
+    printf("\nArray kernels, per element\n");
+    benchArrayKernels(4096, scale * 5000);     // in L1
+    benchArrayKernels(1 << 22, scale * 4 + 1); // in memory
+
+    printf("\nColumns, per row\n");
+    benchColumns(scale * 1000000);
+
+    freeVM(&vm);
+    return 0;
+}
@@ -0,0 +1,103 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "output.h"
+#include "session.h"
+#include "vm.h"
+
+/**
+ * @brief Feeds REPL-style sessions through feedSession, run directly: slorp_sessioncheck
+ *
+ * Checks that a line which compiles on its own also compiles on the end of a session, however
+ * many constants the lines before it left in the chunk, that a line failing to compile leaves
+ * the session usable, and that globals carry over when the session moves to a new chunk.
+ * Every backend is checked, script output goes to /dev/null. Exits with 1 when any line gives an
+ * unexpected result.
+ */
+
+#define LINE_SIZE 4096
+
+static int failures = 0;
+
+static void expect(Session *session, const char *line, InterpretResult expected, const char *what)
+{
+    InterpretResult result = feedSession(session, line);
+    if (result != expected)
+    {
+        printf("backend %d, %s: result %d, expected %d\n", session->vm->backend, what, result, expected);
+        failures++;
+    }
+}
+
+// 125 globals, then one line with 140 new number literals, more than the chunk has room for
+static void checkFullChunk(Session *session)
+{
+    char line[LINE_SIZE];
+    for (int i = 0; i < 125; i++)
+    {
+        snprintf(line, sizeof(line), "var g%d = %d.5;", i, i);
+        expect(session, line, INTERPRET_OK, "global definition");
+    }
+
+    int length = snprintf(line, sizeof(line), "print 0.5");
+    for (int i = 125; i < 265; i++)
+        length += snprintf(line + length, sizeof(line) - length, " + %d.5", i);
+    snprintf(line + length, sizeof(line) - length, ";");
+    expect(session, line, INTERPRET_OK, "line with 140 constants after 125 globals");
+    expect(session, "print g3 + g124;", INTERPRET_OK, "globals after a new chunk");
+}
+
+// Many short lines, each adding constants, run through several chunks
+static void checkManyLines(Session *session)
+{
+    char line[LINE_SIZE];
+    for (int i = 0; i < 1000; i++)
+    {
+        snprintf(line, sizeof(line), "var h%d = \"s%d\"; print h%d;", i % 300, i, i % 300);
+        expect(session, line, INTERPRET_OK, "short line");
+    }
+    expect(session, "print h299;", INTERPRET_OK, "global from an earlier chunk");
+}
+
+static void checkCompileError(Session *session)
+{
+    expect(session, "var broken = ;", INTERPRET_COMPILE_ERROR, "line that does not compile");
+    expect(session, "print g1 + 1;", INTERPRET_OK, "line after a compile error");
+}
+
+int main()
+{
+    int devNull = open("/dev/null", O_WRONLY);
+    FILE *errors = fopen("/dev/null", "w");
+    if (devNull < 0 || errors == NULL)
+    {
+        perror("/dev/null");
+        return 1;
+    }
+
+    const Backend backends[] = {BACKEND_STACK, BACKEND_REGISTER, BACKEND_CACHED};
+    for (int i = 0; i < 3; i++)
+    {
+        VM vm;
+        initVM(&vm);
+        initOutput(&vm.out, devNull, 0, OUTPUT_FLUSH_FULL);
+        vm.err = errors;
+        vm.backend = backends[i];
+        Session session;
+        initSession(&session, &vm);
+
+        checkFullChunk(&session);
+        checkCompileError(&session);
+        checkManyLines(&session);
+
+        freeSession(&session);
+        freeVM(&vm);
+    }
+    fclose(errors);
+    close(devNull);
+    printf("%s\n", failures == 0 ? "sessions ok" : "sessions failed");
+    return failures > 0;
+}
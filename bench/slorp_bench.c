@@ -0,0 +1,384 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * @brief Benchmark runner for the Slorp interpreter
+ *
+ * Every workload is executed as a separate Slorp process `runs` times.
+ * Wall time is measured around fork/exec/wait and peak RSS is taken from the
+ * child's rusage. Results are written as JSON, optionally compared against
+ * a JSON file from an earlier run (the baseline).
+ */
+
+#define MAX_WORKLOADS 64
+#define DEFAULT_RUNS 20
+#define DEFAULT_WARMUP 2
+#define DEFAULT_THRESHOLD 10.0
+
+typedef struct
+{
+    const char *path;
+    const char *name; // basename of path without extension
+    double *samples;  // wall time in milliseconds, one per run
+    int sampleCount;
+    long peakRssKb;
+    int exitCode;
+} Workload;
+
+typedef struct
+{
+    const char *slorp;
+    const char *baseline;
+    const char *output;
+    int runs;
+    int warmup;
+    double threshold; // percentage the median may grow before it is a regression
+} Options;
+
+static double nowMs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/**
+ * @brief Runs slorp on `path` once with stdout discarded
+ * @return wall time in milliseconds, peak RSS and exit code through the out parameters
+ */
+static bool runOnce(const char *slorp, const char *path, double *wallMs, long *rssKb, int *exitCode)
+{
+    double start = nowMs();
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        perror("fork");
+        return false;
+    }
+
+    if (pid == 0)
+    {
+        int devNull = open("/dev/null", O_WRONLY);
+        if (devNull >= 0)
+        {
+            dup2(devNull, STDOUT_FILENO);
+            close(devNull);
+        }
+        execl(slorp, slorp, path, (char *)NULL);
+        _exit(127); // exec failed
+    }
+
+    int status = 0;
+    struct rusage usage;
+    while (wait4(pid, &status, 0, &usage) < 0)
+    {
+        if (errno != EINTR)
+        {
+            perror("wait4");
+            return false;
+        }
+    }
+    *wallMs = nowMs() - start;
+
+#ifdef __APPLE__
+    *rssKb = usage.ru_maxrss / 1024; // bytes on macOS
+#else
+    *rssKb = usage.ru_maxrss; // kilobytes on Linux
+#endif
+    *exitCode = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    return true;
+}
+
+static int compareDoubles(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile over sorted samples
+static double percentile(const double *sorted, int count, double p)
+{
+    if (count == 0)
+        return 0.0;
+    int rank = (int)(p / 100.0 * count + 0.999999);
+    if (rank < 1)
+        rank = 1;
+    if (rank > count)
+        rank = count;
+    return sorted[rank - 1];
+}
+
+static const char *workloadName(const char *path)
+{
+    const char *slash = strrchr(path, '/');
+    const char *base = slash != NULL ? slash + 1 : path;
+    const char *dot = strrchr(base, '.');
+    size_t length = dot != NULL ? (size_t)(dot - base) : strlen(base);
+    return strndup(base, length);
+}
+
+static void benchWorkload(const Options *options, Workload *workload)
+{
+    workload->samples = malloc(sizeof(double) * options->runs);
+    workload->sampleCount = 0;
+    workload->peakRssKb = 0;
+    workload->exitCode = 0;
+
+    for (int i = 0; i < options->warmup + options->runs; i++)
+    {
+        double wallMs;
+        long rssKb;
+        int exitCode;
+        if (!runOnce(options->slorp, workload->path, &wallMs, &rssKb, &exitCode))
+            exit(1);
+
+        if (exitCode != 0)
+            workload->exitCode = exitCode;
+        if (i < options->warmup)
+            continue; // Warm the page cache and the binary, don't record
+
+        workload->samples[workload->sampleCount++] = wallMs;
+        if (rssKb > workload->peakRssKb)
+            workload->peakRssKb = rssKb;
+    }
+
+    qsort(workload->samples, workload->sampleCount, sizeof(double), compareDoubles);
+}
+
+static void writeJson(FILE *out, const Options *options, Workload *workloads, int count)
+{
+    fprintf(out, "{\n  \"runs\": %d,\n  \"workloads\": [\n", options->runs);
+    for (int i = 0; i < count; i++)
+    {
+        Workload *w = &workloads[i];
+        double sum = 0.0;
+        for (int s = 0; s < w->sampleCount; s++)
+            sum += w->samples[s];
+
+        fprintf(out, "    {\n");
+        fprintf(out, "      \"name\": \"%s\",\n", w->name);
+        fprintf(out, "      \"path\": \"%s\",\n", w->path);
+        fprintf(out, "      \"exit_code\": %d,\n", w->exitCode);
+        fprintf(out, "      \"min_ms\": %.4f,\n", w->samples[0]);
+        fprintf(out, "      \"mean_ms\": %.4f,\n", sum / w->sampleCount);
+        fprintf(out, "      \"median_ms\": %.4f,\n", percentile(w->samples, w->sampleCount, 50));
+        fprintf(out, "      \"p90_ms\": %.4f,\n", percentile(w->samples, w->sampleCount, 90));
+        fprintf(out, "      \"p99_ms\": %.4f,\n", percentile(w->samples, w->sampleCount, 99));
+        fprintf(out, "      \"max_ms\": %.4f,\n", w->samples[w->sampleCount - 1]);
+        fprintf(out, "      \"peak_rss_kb\": %ld\n", w->peakRssKb);
+        fprintf(out, "    }%s\n", i + 1 < count ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+}
+
+static char *readFile(const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+        return NULL;
+
+    fseek(file, 0L, SEEK_END);
+    size_t size = ftell(file);
+    rewind(file);
+
+    char *buffer = malloc(size + 1);
+    size_t bytesRead = fread(buffer, 1, size, file);
+    buffer[bytesRead] = '\0';
+    fclose(file);
+    return buffer;
+}
+
+/**
+ * @brief Finds `"key": <number>` inside the baseline object of workload `name`
+ * The baseline is a file this program wrote, so a targeted search is enough - no general JSON parser
+ */
+static bool baselineValue(const char *json, const char *name, const char *key, double *value)
+{
+    char needle[256];
+    snprintf(needle, sizeof(needle), "\"name\": \"%s\"", name);
+    const char *object = strstr(json, needle);
+    if (object == NULL)
+        return false;
+
+    const char *end = strchr(object, '}');
+    snprintf(needle, sizeof(needle), "\"%s\":", key);
+    const char *field = strstr(object, needle);
+    if (field == NULL || (end != NULL && field > end))
+        return false;
+
+    *value = strtod(field + strlen(needle), NULL);
+    return true;
+}
+
+/**
+ * @brief Prints a comparison against the baseline to stderr
+ * @return number of workloads whose median regressed past the threshold
+ */
+static int compareBaseline(const Options *options, Workload *workloads, int count)
+{
+    char *json = readFile(options->baseline);
+    if (json == NULL)
+    {
+        fprintf(stderr, "Could not read baseline \"%s\".\n", options->baseline);
+        exit(74);
+    }
+
+    int regressions = 0;
+    fprintf(stderr, "%-16s %12s %12s %9s %12s %12s\n",
+            "workload", "base ms", "median ms", "delta", "base rss", "rss kb");
+    for (int i = 0; i < count; i++)
+    {
+        Workload *w = &workloads[i];
+        double median = percentile(w->samples, w->sampleCount, 50);
+        double baseMedian, baseRss;
+        if (!baselineValue(json, w->name, "median_ms", &baseMedian) ||
+            !baselineValue(json, w->name, "peak_rss_kb", &baseRss))
+        {
+            fprintf(stderr, "%-16s %12s %12.4f\n", w->name, "(new)", median);
+            continue;
+        }
+
+        double delta = baseMedian > 0.0 ? (median - baseMedian) / baseMedian * 100.0 : 0.0;
+        bool regressed = delta > options->threshold;
+        if (regressed)
+            regressions++;
+        fprintf(stderr, "%-16s %12.4f %12.4f %+8.1f%% %12.0f %12ld%s\n",
+                w->name, baseMedian, median, delta, baseRss, w->peakRssKb,
+                regressed ? "  REGRESSION" : "");
+    }
+
+    free(json);
+    return regressions;
+}
+
+/**
+ * @brief Writes a large source file for the compile-time workload
+ * Nested blocks of local declarations and assignments keep the script inside the
+ * compilers constant-pool and local-slot limits while still being arbitrarily long.
+ */
+static void generateHugeSource(const char *path, long lines)
+{
+    FILE *out = fopen(path, "w");
+    if (out == NULL)
+    {
+        fprintf(stderr, "Could not open \"%s\" for writing.\n", path);
+        exit(74);
+    }
+
+    fprintf(out, "// Generated: compile-time workload, %ld statements.\n", lines);
+    long written = 0;
+    while (written < lines)
+    {
+        fprintf(out, "{\n    var a; var b; var c; var d;\n");
+        for (int i = 0; i < 200 && written < lines; i++, written++)
+        {
+            fprintf(out, "    a = b; b = c; c = d; d = a == b; a = !d;\n");
+        }
+        fprintf(out, "}\n");
+    }
+    fclose(out);
+}
+
+static void usage()
+{
+    fprintf(stderr,
+            "Usage: slorp_bench --slorp <path> [--runs N] [--warmup N] [--output file]\n"
+            "                   [--baseline file] [--threshold percent] workload...\n"
+            "       slorp_bench --gen-huge <path> <statements>\n");
+    exit(64);
+}
+
+int main(int argc, const char *argv[])
+{
+    if (argc == 4 && strcmp(argv[1], "--gen-huge") == 0)
+    {
+        generateHugeSource(argv[2], atol(argv[3]));
+        return 0;
+    }
+
+    Options options = {
+        .slorp = NULL,
+        .baseline = NULL,
+        .output = NULL,
+        .runs = DEFAULT_RUNS,
+        .warmup = DEFAULT_WARMUP,
+        .threshold = DEFAULT_THRESHOLD,
+    };
+    Workload workloads[MAX_WORKLOADS];
+    int workloadCount = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--slorp") == 0 && hasValue)
+            options.slorp = argv[++i];
+        else if (strcmp(argv[i], "--runs") == 0 && hasValue)
+            options.runs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--warmup") == 0 && hasValue)
+            options.warmup = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--output") == 0 && hasValue)
+            options.output = argv[++i];
+        else if (strcmp(argv[i], "--baseline") == 0 && hasValue)
+            options.baseline = argv[++i];
+        else if (strcmp(argv[i], "--threshold") == 0 && hasValue)
+            options.threshold = atof(argv[++i]);
+        else if (argv[i][0] == '-')
+            usage();
+        else if (workloadCount < MAX_WORKLOADS)
+        {
+            workloads[workloadCount].path = argv[i];
+            workloads[workloadCount].name = workloadName(argv[i]);
+            workloadCount++;
+        }
+    }
+
+    if (options.slorp == NULL || workloadCount == 0 || options.runs < 1)
+        usage();
+
+    for (int i = 0; i < workloadCount; i++)
+    {
+        fprintf(stderr, "bench %s (%d runs)\n", workloads[i].name, options.runs);
+        benchWorkload(&options, &workloads[i]);
+    }
+
+    writeJson(stdout, &options, workloads, workloadCount);
+    if (options.output != NULL)
+    {
+        FILE *out = fopen(options.output, "w");
+        if (out == NULL)
+        {
+            fprintf(stderr, "Could not open \"%s\" for writing.\n", options.output);
+            return 74;
+        }
+        writeJson(out, &options, workloads, workloadCount);
+        fclose(out);
+    }
+
+    int failed = 0;
+    for (int i = 0; i < workloadCount; i++)
+    {
+        if (workloads[i].exitCode != 0)
+        {
+            fprintf(stderr, "workload %s exited with %d\n", workloads[i].name, workloads[i].exitCode);
+            failed = 1;
+        }
+    }
+
+    if (options.baseline != NULL && compareBaseline(&options, workloads, workloadCount) > 0)
+        return 1;
+
+    return failed;
+}
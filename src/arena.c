@@ -0,0 +1,62 @@
+#include "include/arena.h"
+
+#include "include/memory.h"
+
+#include <stdalign.h>
+#include <stdint.h>
+
+struct ArenaBlock
+{
+    ArenaBlock *next;
+    size_t size; // usable bytes after the header
+    size_t used;
+    alignas(max_align_t) unsigned char bytes[];
+};
+
+void initArena(Arena *arena, VM *vm)
+{
+    arena->vm = vm;
+    arena->blocks = NULL;
+}
+
+void freeArena(Arena *arena)
+{
+    ArenaBlock *block = arena->blocks;
+    while (block != NULL)
+    {
+        ArenaBlock *next = block->next;
+        reallocate(arena->vm, block, sizeof(ArenaBlock) + block->size, 0);
+        block = next;
+    }
+    arena->blocks = NULL;
+}
+
+void *arenaAlloc(Arena *arena, size_t size)
+{
+    size = (size + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1);
+
+    ArenaBlock *block = arena->blocks;
+    if (block == NULL || block->size - block->used < size)
+    {
+        // Oversized requests get a block of their own, the head keeps serving small ones
+        size_t blockSize = size > ARENA_BLOCK_SIZE / 4 ? size : ARENA_BLOCK_SIZE;
+        ArenaBlock *fresh = reallocate(arena->vm, NULL, 0, sizeof(ArenaBlock) + blockSize);
+        fresh->size = blockSize;
+        fresh->used = 0;
+        if (block != NULL && blockSize != ARENA_BLOCK_SIZE)
+        {
+            fresh->next = block->next;
+            block->next = fresh;
+        }
+        else
+        {
+            fresh->next = block;
+            arena->blocks = fresh;
+        }
+        block = fresh;
+    }
+
+    void *result = block->bytes + block->used;
+    block->used += size;
+    return result;
+}
@@ -0,0 +1,185 @@
+#include "include/array.h"
+
+#include <math.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*
+ * Two doubles, a 128 bit register: SSE2 on every x86-64, NEON on arm64. GCC lowers wider vector
+ * types through memory on targets without them, which is slower than not vectorizing at all.
+ * The reductions keep four of them in flight, so consecutive additions don't wait on each other.
+ */
+#define LANES 2
+#define STRIDE (4 * LANES)
+
+typedef double Lanes __attribute__((vector_size(LANES * sizeof(double))));
+// Lanes at any double's address, the array elements are only aligned for a double
+typedef double UnalignedLanes __attribute__((vector_size(LANES * sizeof(double)), aligned(sizeof(double)), may_alias));
+
+static inline Lanes load(const double *values)
+{
+    return *(const UnalignedLanes *)values;
+}
+
+static inline void store(double *values, Lanes lanes)
+{
+    *(UnalignedLanes *)values = lanes;
+}
+
+static const char *methodNames[ARRAY_METHOD_COUNT] = {
+    [ARRAY_LENGTH] = "length",
+    [ARRAY_SUM] = "sum",
+    [ARRAY_MIN] = "min",
+    [ARRAY_MAX] = "max",
+    [ARRAY_DOT] = "dot",
+    [ARRAY_ADD] = "add",
+    [ARRAY_MUL] = "mul",
+    [ARRAY_SCALE] = "scale",
+};
+
+const char *arrayMethodName(ArrayMethod method)
+{
+    return methodNames[method];
+}
+
+bool findArrayMethod(const char *name, int length, ArrayMethod *method)
+{
+    for (int i = 0; i < ARRAY_METHOD_COUNT; i++)
+    {
+        if ((int)strlen(methodNames[i]) == length && memcmp(methodNames[i], name, length) == 0)
+        {
+            *method = (ArrayMethod)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// A NaN candidate wins, and nothing replaces a NaN, so a NaN anywhere is the result
+static inline double pickMin(double current, double candidate)
+{
+    return candidate < current || candidate != candidate ? candidate : current;
+}
+
+static inline double pickMax(double current, double candidate)
+{
+    return candidate > current || candidate != candidate ? candidate : current;
+}
+
+double sumDoubles(const double *values, int count)
+{
+    Lanes first = {0}, second = {0}, third = {0}, fourth = {0};
+    int i = 0;
+    for (; i + STRIDE <= count; i += STRIDE)
+    {
+        first += load(values + i);
+        second += load(values + i + LANES);
+        third += load(values + i + 2 * LANES);
+        fourth += load(values + i + 3 * LANES);
+    }
+
+    Lanes lanes = (first + second) + (third + fourth);
+    double sum = lanes[0] + lanes[1];
+    for (; i < count; i++)
+        sum += values[i];
+    return sum;
+}
+
+#ifdef __SSE2__
+/*
+ * min and max need a per lane select, which GCC only emits as vector code from SSE4.1 on and
+ * turns into a scalar loop of branches below that. minpd and maxpd are that select on SSE2
+ * already: minpd(a, b) is a < b ? a : b, so a NaN in `a` is dropped, it is tracked on the side.
+ */
+static double extremeDoubles(const double *values, int count, bool min)
+{
+    Lanes first = {values[0], values[0]}, second = first, nan = {0};
+    int i = 0;
+    for (; i + 2 * LANES <= count; i += 2 * LANES)
+    {
+        Lanes low = load(values + i);
+        Lanes high = load(values + i + LANES);
+        first = min ? _mm_min_pd(low, first) : _mm_max_pd(low, first);
+        second = min ? _mm_min_pd(high, second) : _mm_max_pd(high, second);
+        nan = _mm_or_pd(nan, _mm_or_pd(_mm_cmpunord_pd(low, low), _mm_cmpunord_pd(high, high)));
+    }
+    if (_mm_movemask_pd(nan) != 0)
+        return NAN;
+
+    double result = first[0];
+    result = min ? pickMin(result, first[1]) : pickMax(result, first[1]);
+    result = min ? pickMin(result, second[0]) : pickMax(result, second[0]);
+    result = min ? pickMin(result, second[1]) : pickMax(result, second[1]);
+    for (; i < count; i++)
+        result = min ? pickMin(result, values[i]) : pickMax(result, values[i]);
+    return result;
+}
+#else
+static double extremeDoubles(const double *values, int count, bool min)
+{
+    double result = values[0];
+    for (int i = 1; i < count; i++)
+        result = min ? pickMin(result, values[i]) : pickMax(result, values[i]);
+    return result;
+}
+#endif
+
+double minDoubles(const double *values, int count)
+{
+    return extremeDoubles(values, count, true);
+}
+
+double maxDoubles(const double *values, int count)
+{
+    return extremeDoubles(values, count, false);
+}
+
+double dotDoubles(const double *a, const double *b, int count)
+{
+    Lanes first = {0}, second = {0}, third = {0}, fourth = {0};
+    int i = 0;
+    for (; i + STRIDE <= count; i += STRIDE)
+    {
+        first += load(a + i) * load(b + i);
+        second += load(a + i + LANES) * load(b + i + LANES);
+        third += load(a + i + 2 * LANES) * load(b + i + 2 * LANES);
+        fourth += load(a + i + 3 * LANES) * load(b + i + 3 * LANES);
+    }
+
+    Lanes lanes = (first + second) + (third + fourth);
+    double dot = lanes[0] + lanes[1];
+    for (; i < count; i++)
+        dot += a[i] * b[i];
+    return dot;
+}
+
+void addDoubles(double *result, const double *a, const double *b, int count)
+{
+    int i = 0;
+    for (; i + LANES <= count; i += LANES)
+        store(result + i, load(a + i) + load(b + i));
+    for (; i < count; i++)
+        result[i] = a[i] + b[i];
+}
+
+void mulDoubles(double *result, const double *a, const double *b, int count)
+{
+    int i = 0;
+    for (; i + LANES <= count; i += LANES)
+        store(result + i, load(a + i) * load(b + i));
+    for (; i < count; i++)
+        result[i] = a[i] * b[i];
+}
+
+void scaleDoubles(double *result, const double *values, double factor, int count)
+{
+    Lanes factors = {factor, factor};
+    int i = 0;
+    for (; i + LANES <= count; i += LANES)
+        store(result + i, load(values + i) * factors);
+    for (; i < count; i++)
+        result[i] = values[i] * factor;
+}
@@ -0,0 +1,238 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "include/batch.h"
+
+#include "include/chunk.h"
+#include "include/compiler.h"
+#include "include/vm.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef enum
+{
+    SCRIPT_OK,
+    SCRIPT_UNREADABLE,
+    SCRIPT_COMPILE_ERROR,
+    SCRIPT_RUNTIME_ERROR,
+} ScriptStatus;
+
+typedef struct
+{
+    const char *path;
+    Chunk chunk;
+    ScriptStatus status;
+    double compileMs;
+    double runMs;
+    char *output; // everything the script printed
+    size_t outputLength;
+    size_t outputCapacity;
+} BatchScript;
+
+typedef struct
+{
+    BatchScript *scripts;
+    int count;
+    Backend backend; // of the compiling VM, the chunks were prepared for it
+    int diagnostics;
+    atomic_int next; // index of the next script a worker claims
+} BatchQueue;
+
+static double nowMs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// Like main.c's readFile, but a missing file fails one script instead of the process
+static char *readSource(const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+        return NULL;
+
+    fseek(file, 0L, SEEK_END);
+    const size_t fileSize = ftell(file);
+    rewind(file);
+
+    char *buffer = (char *)malloc(fileSize + 1);
+    size_t bytesRead = buffer != NULL ? fread(buffer, sizeof(char), fileSize, file) : 0;
+    fclose(file);
+    if (buffer == NULL || bytesRead < fileSize)
+    {
+        free(buffer);
+        return NULL;
+    }
+    buffer[bytesRead] = '\0';
+    return buffer;
+}
+
+static void compileScript(VM *vm, BatchScript *script)
+{
+    initChunk(&script->chunk);
+    char *source = readSource(script->path);
+    if (source == NULL)
+    {
+        fprintf(stderr, "Could not read file \"%s\".\n", script->path);
+        script->status = SCRIPT_UNREADABLE;
+        return;
+    }
+
+    double start = nowMs();
+    bool compiled = compile(vm, source, &script->chunk);
+    script->compileMs = nowMs() - start;
+    script->status = compiled ? SCRIPT_OK : SCRIPT_COMPILE_ERROR;
+    free(source);
+}
+
+// Output sink of a batch VM, collects the output until the batch is over
+static bool appendOutput(void *context, const char *bytes, size_t length)
+{
+    BatchScript *script = context;
+    if (script->outputCapacity < script->outputLength + length)
+    {
+        size_t capacity = script->outputCapacity < 256 ? 256 : script->outputCapacity;
+        while (capacity < script->outputLength + length)
+            capacity *= 2;
+        char *output = realloc(script->output, capacity);
+        if (output == NULL)
+            return false;
+        script->output = output;
+        script->outputCapacity = capacity;
+    }
+    memcpy(script->output + script->outputLength, bytes, length);
+    script->outputLength += length;
+    return true;
+}
+
+static void runScript(BatchQueue *queue, BatchScript *script)
+{
+    VM vm;
+    initVM(&vm);
+    vm.backend = queue->backend;
+    vm.diagnostics = queue->diagnostics;
+    setOutputSink(&vm.out, appendOutput, script);
+
+    double start = nowMs();
+    if (runChunk(&vm, &script->chunk) != INTERPRET_OK)
+        script->status = SCRIPT_RUNTIME_ERROR;
+    script->runMs = nowMs() - start;
+
+    freeVM(&vm);
+}
+
+static void *worker(void *argument)
+{
+    BatchQueue *queue = argument;
+    for (;;)
+    {
+        int index = atomic_fetch_add(&queue->next, 1);
+        if (index >= queue->count)
+            return NULL;
+
+        BatchScript *script = &queue->scripts[index];
+        if (script->status == SCRIPT_OK)
+            runScript(queue, script);
+    }
+}
+
+static const char *statusName(ScriptStatus status)
+{
+    switch (status)
+    {
+    case SCRIPT_OK:
+        return "ok";
+    case SCRIPT_UNREADABLE:
+        return "unreadable";
+    case SCRIPT_COMPILE_ERROR:
+        return "compile error";
+    case SCRIPT_RUNTIME_ERROR:
+        return "runtime error";
+    }
+    return "?";
+}
+
+static int exitCodeFor(ScriptStatus status)
+{
+    switch (status)
+    {
+    case SCRIPT_UNREADABLE:
+        return 74;
+    case SCRIPT_COMPILE_ERROR:
+        return 65;
+    case SCRIPT_RUNTIME_ERROR:
+        return 70;
+    default:
+        return 0;
+    }
+}
+
+int runBatch(VM *vm, const char *const *paths, int count, int jobs, FILE *report)
+{
+    if (jobs <= 0)
+        jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (jobs > count)
+        jobs = count;
+    if (jobs < 1)
+        jobs = 1;
+
+    BatchQueue queue;
+    queue.scripts = calloc(count, sizeof(BatchScript));
+    queue.count = count;
+    queue.backend = vm->backend;
+    queue.diagnostics = vm->diagnostics;
+    atomic_init(&queue.next, 0);
+
+    double start = nowMs();
+    for (int i = 0; i < count; i++)
+    {
+        queue.scripts[i].path = paths[i];
+        compileScript(vm, &queue.scripts[i]);
+    }
+    double compiledAt = nowMs();
+
+    // The calling thread is one of the workers
+    pthread_t *threads = malloc(sizeof(pthread_t) * jobs);
+    int started = 0;
+    for (int i = 1; i < jobs; i++)
+    {
+        if (pthread_create(&threads[started], NULL, worker, &queue) == 0)
+            started++;
+    }
+    worker(&queue);
+    for (int i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+    double finishedAt = nowMs();
+    free(threads);
+
+    int exitCode = 0;
+    fprintf(report, "%-40s %-14s %12s %12s %12s\n", "script", "status", "compile ms", "run ms", "output bytes");
+    for (int i = 0; i < count; i++)
+    {
+        BatchScript *script = &queue.scripts[i];
+        if (script->output != NULL)
+            writeOutput(&vm->out, script->output, script->outputLength);
+
+        fprintf(report, "%-40s %-14s %12.4f %12.4f %12zu\n", script->path, statusName(script->status),
+                script->compileMs, script->runMs, script->outputLength);
+        if (exitCode == 0)
+            exitCode = exitCodeFor(script->status);
+
+        free(script->output);
+        freeChunk(vm, &script->chunk);
+    }
+    flushOutput(&vm->out);
+
+    double runMs = finishedAt - compiledAt;
+    fprintf(report, "%d scripts on %d threads: compile %.3f ms, run %.3f ms, %.0f scripts/s\n",
+            count, started + 1, compiledAt - start, runMs,
+            runMs > 0.0 ? count / (runMs / 1000.0) : 0.0);
+
+    free(queue.scripts);
+    return exitCode;
+}
@@ -1,6 +1,10 @@
 #include <stdlib.h>
 #include "include/chunk.h"
 #include "include/memory.h"
+#include "include/object.h"
+#include "include/regcode.h"
+#include "include/verifier.h"
+#include "include/vm.h"
 
 void initChunk(Chunk *chunk)
 {
@@ -8,35 +12,170 @@ void initChunk(Chunk *chunk)
     chunk->capacity = 0;
     chunk->code = NULL;
     chunk->lines = NULL;
+    chunk->verified = false;
+    chunk->maxStackDepth = 0;
+    chunk->preparedCount = 0;
+    chunk->instructions = NULL;
+    chunk->instructionCount = 0;
+    chunk->instructionCapacity = 0;
+    chunk->registerCode = NULL;
+    chunk->registerCodeCount = 0;
+    chunk->registerCodeCapacity = 0;
+    chunk->registerCount = 0;
+    chunk->registerSlots = 0;
+    chunk->translatedCount = 0;
     initValueArray(&chunk->constants);
 }
 
-void writeChunk(Chunk *chunk, uint8_t byte, int line)
+// Drops the register code of everything from `count` on, translateRegisters redoes it from there
+static void truncateRegisterCode(Chunk *chunk, int count)
 {
-    bool need_to_grow = chunk->capacity < chunk->capacity + 1;
+    while (chunk->registerCodeCount > 0 && chunk->registerCode[chunk->registerCodeCount - 1].offset >= count)
+        chunk->registerCodeCount--;
+    if (chunk->translatedCount > count)
+        chunk->translatedCount = count;
+}
+
+void writeChunk(VM *vm, Chunk *chunk, uint8_t byte, int line)
+{
+    bool need_to_grow = chunk->capacity < chunk->count + 1;
     if (need_to_grow)
     {
         int oldCapacity = chunk->capacity;
         chunk->capacity = GROW_CAPACITY(oldCapacity);
-        chunk->code = GROW_ARRAY(uint8_t, chunk->code, oldCapacity, chunk->capacity);
-        chunk->lines = GROW_ARRAY(int, chunk->lines, oldCapacity, chunk->capacity);
+        chunk->code = GROW_ARRAY(vm, uint8_t, chunk->code, oldCapacity, chunk->capacity);
+        chunk->lines = GROW_ARRAY(vm, int, chunk->lines, oldCapacity, chunk->capacity);
     }
 
+    chunk->verified = false;
     chunk->code[chunk->count] = byte;
     chunk->lines[chunk->count] = line;
     chunk->count++;
 }
 
-void freeChunk(Chunk *chunk)
+void freeChunk(VM *vm, Chunk *chunk)
 {
-    FREE_ARRAY(uint8_t, chunk->code, chunk->capacity);
-    FREE_ARRAY(int, chunk->lines, chunk->capacity);
-    freeValueArray(&chunk->constants);
+    FREE_ARRAY(vm, Instr, chunk->instructions, chunk->instructionCapacity);
+    FREE_ARRAY(vm, RegInstr, chunk->registerCode, chunk->registerCodeCapacity);
+    FREE_ARRAY(vm, uint8_t, chunk->code, chunk->capacity);
+    FREE_ARRAY(vm, int, chunk->lines, chunk->capacity);
+    freeValueArray(vm, &chunk->constants);
     initChunk(chunk);
 }
 
-int addConstant(Chunk *chunk, Value value)
+int addConstant(VM *vm, Chunk *chunk, Value value)
 {
-    writeValueArray(&chunk->constants, value);
+    writeValueArray(vm, &chunk->constants, value);
     return chunk->constants.count - 1; // return the index to where the constant was appended, for lookup
 }
+
+// Appends the records for the code from `start` on, only called on verified code so every operand is in range
+static void decodeChunk(VM *vm, Chunk *chunk, int start)
+{
+    int count = chunk->instructionCount;
+    for (int offset = start; offset < chunk->count; count++)
+    {
+        uint8_t op = chunk->code[offset];
+        bool hasOperand = op == OP_CONSTANT || op == OP_DEFINE_GLOBAL || op == OP_GET_GLOBAL ||
+                          op == OP_SET_GLOBAL || op == OP_GET_LOCAL || op == OP_SET_LOCAL || op == OP_ARRAY ||
+                          op == OP_ARRAY_UNARY || op == OP_ARRAY_BINARY || op == OP_MAP;
+        bool hasLongOperand = op == OP_GET_LOCAL_LONG || op == OP_SET_LOCAL_LONG;
+        offset += hasLongOperand ? 3 : hasOperand ? 2 : 1;
+    }
+
+    if (chunk->instructionCapacity < count)
+    {
+        int oldCapacity = chunk->instructionCapacity;
+        int capacity = GROW_CAPACITY(oldCapacity);
+        chunk->instructionCapacity = capacity < count ? count : capacity;
+        chunk->instructions = GROW_ARRAY(vm, Instr, chunk->instructions, oldCapacity, chunk->instructionCapacity);
+    }
+
+    int offset = start;
+    for (int i = chunk->instructionCount; i < count; i++)
+    {
+        Instr *instr = &chunk->instructions[i];
+        instr->op = chunk->code[offset];
+        instr->offset = offset;
+        instr->as.constant = NIL_VAL;
+        switch (instr->op)
+        {
+        case OP_CONSTANT:
+            instr->as.constant = chunk->constants.values[chunk->code[offset + 1]];
+            offset += 2;
+            break;
+        case OP_DEFINE_GLOBAL:
+        case OP_GET_GLOBAL:
+        case OP_SET_GLOBAL:
+            instr->as.name = AS_STRING(chunk->constants.values[chunk->code[offset + 1]]);
+            offset += 2;
+            break;
+        case OP_GET_LOCAL:
+        case OP_SET_LOCAL:
+            instr->as.slot = chunk->code[offset + 1];
+            offset += 2;
+            break;
+        case OP_GET_LOCAL_LONG:
+        case OP_SET_LOCAL_LONG:
+            instr->op = instr->op == OP_GET_LOCAL_LONG ? OP_GET_LOCAL : OP_SET_LOCAL;
+            instr->as.slot = chunk->code[offset + 1] << 8 | chunk->code[offset + 2];
+            offset += 3;
+            break;
+        case OP_ARRAY:
+        case OP_MAP:
+            instr->as.count = chunk->code[offset + 1];
+            offset += 2;
+            break;
+        case OP_ARRAY_UNARY:
+        case OP_ARRAY_BINARY:
+            instr->as.method = chunk->code[offset + 1];
+            offset += 2;
+            break;
+        default:
+            offset++;
+            break;
+        }
+    }
+
+    chunk->instructionCount = count;
+}
+
+const char *prepareChunk(VM *vm, Chunk *chunk, int *errorOffset)
+{
+    if (!chunk->verified)
+    {
+        const char *problem = verifyChunk(chunk, chunk->preparedCount, errorOffset);
+        if (problem != NULL)
+            return problem;
+    }
+    if (chunk->preparedCount < chunk->count)
+    {
+        decodeChunk(vm, chunk, chunk->preparedCount);
+        chunk->preparedCount = chunk->count;
+    }
+    if (vm->backend == BACKEND_REGISTER && chunk->translatedCount < chunk->count)
+        translateRegisters(vm, chunk);
+    return NULL;
+}
+
+int reopenChunk(Chunk *chunk)
+{
+    if (chunk->count == 0)
+        return 0;
+
+    // The last record is the OP_RETURN, the verifier left the stack empty before it
+    chunk->count--;
+    chunk->instructionCount--;
+    chunk->preparedCount = chunk->count;
+    chunk->verified = false;
+    truncateRegisterCode(chunk, chunk->count);
+    return chunk->count;
+}
+
+void rewindChunk(Chunk *chunk, int count, int constantCount)
+{
+    chunk->count = count;
+    chunk->constants.count = constantCount;
+    chunk->verified = false;
+    truncateRegisterCode(chunk, count);
+}
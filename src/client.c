@@ -0,0 +1,206 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "include/common.h"
+#include "include/compiler.h"
+#include "include/serialize.h"
+#include "include/server.h"
+#include "include/vm.h"
+
+/**
+ * @brief slorp_client, runs scripts on a `slorp --serve` daemon
+ * Output and errors of every script are copied to stdout and stderr as they stream in,
+ * the exit code is that of the first script that failed, like `slorp <path>`.
+ */
+
+typedef struct
+{
+    const char *socketPath;
+    bool compileLocally; // send bytecode instead of source
+    bool showTiming;
+} Options;
+
+static double nowMs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static char *readFile(const char *path, size_t *length)
+{
+    FILE *file = fopen(path, "rb");
+    HANDLE_ERROR(file == NULL, "Could not open file \"%s\".\n", path);
+
+    fseek(file, 0L, SEEK_END);
+    const size_t fileSize = ftell(file);
+    rewind(file);
+
+    char *buffer = (char *)malloc(fileSize + 1);
+    HANDLE_ERROR(buffer == NULL, "Not enough memory to read \"%s\".\n", path);
+    size_t bytesRead = fread(buffer, sizeof(char), fileSize, file);
+    HANDLE_ERROR(bytesRead < fileSize, "Could not read file \"%s\".\n", path);
+    buffer[bytesRead] = '\0';
+
+    fclose(file);
+    *length = bytesRead;
+    return buffer;
+}
+
+static int connectTo(const char *socketPath)
+{
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socketPath, sizeof(address.sun_path) - 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&address, sizeof(address)) < 0)
+    {
+        perror(socketPath);
+        exit(69);
+    }
+    return fd;
+}
+
+static int exitCodeFor(uint32_t result)
+{
+    switch (result)
+    {
+    case INTERPRET_COMPILE_ERROR:
+        return 65;
+    case INTERPRET_RUNTIME_ERROR:
+        return 70;
+    default:
+        return 0;
+    }
+}
+
+/**
+ * @brief Builds the request for one script, source as is, bytecode files as bytecode
+ * With --compile the source is compiled here and sent as bytecode
+ * @return malloc'ed payload, or NULL after a local compile error
+ */
+static uint8_t *buildRequest(const Options *options, const char *path, uint8_t *type, size_t *length)
+{
+    char *source = readFile(path, length);
+    if (isBytecode((uint8_t *)source, *length))
+    {
+        *type = FRAME_BYTECODE;
+        return (uint8_t *)source;
+    }
+
+    *type = FRAME_SOURCE;
+    if (!options->compileLocally)
+        return (uint8_t *)source;
+
+    VM vm;
+    initVM(&vm);
+    Chunk chunk;
+    initChunk(&chunk);
+    uint8_t *bytes = NULL;
+    if (compile(&vm, source, &chunk))
+    {
+        bytes = serializeChunk(&chunk, length);
+        *type = FRAME_BYTECODE;
+    }
+    freeChunk(&vm, &chunk);
+    freeVM(&vm);
+    free(source);
+    return bytes;
+}
+
+// Sends one script and relays the answer, returns its exit code
+static int runScript(const Options *options, int server, const char *path)
+{
+    uint8_t type;
+    size_t length;
+    uint8_t *request = buildRequest(options, path, &type, &length);
+    if (request == NULL)
+        return 65;
+
+    double start = nowMs();
+    bool sent = length <= FRAME_MAX_PAYLOAD && writeFrame(server, type, request, (uint32_t)length);
+    free(request);
+    if (!sent)
+    {
+        fprintf(stderr, "Could not send \"%s\" to the server.\n", path);
+        return 74;
+    }
+
+    uint8_t *payload;
+    uint32_t payloadLength;
+    while (readFrame(server, &type, &payload, &payloadLength))
+    {
+        if (type == FRAME_OUTPUT || type == FRAME_ERROR)
+        {
+            fwrite(payload, 1, payloadLength, type == FRAME_OUTPUT ? stdout : stderr);
+            free(payload);
+            continue;
+        }
+
+        DoneFrame done;
+        bool valid = type == FRAME_DONE && decodeDone(payload, payloadLength, &done);
+        free(payload);
+        if (!valid)
+            break;
+
+        fflush(stdout);
+        if (options->showTiming)
+            fprintf(stderr, "%s:%s compile %.3f ms, run %.3f ms, round trip %.3f ms\n", path,
+                    done.cached ? " (cached)" : "", done.compileUs / 1000.0, done.runUs / 1000.0,
+                    nowMs() - start);
+        return exitCodeFor(done.result);
+    }
+
+    fprintf(stderr, "Lost the connection to the server.\n");
+    return 74;
+}
+
+static void usage()
+{
+    fprintf(stderr, "Usage: slorp_client [--socket path] [--compile] [--time] path...\n");
+    exit(64);
+}
+
+int main(int argc, const char *argv[])
+{
+    Options options = {SERVER_DEFAULT_SOCKET, false, false};
+    int first = argc;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc)
+            options.socketPath = argv[++i];
+        else if (strcmp(argv[i], "--compile") == 0)
+            options.compileLocally = true;
+        else if (strcmp(argv[i], "--time") == 0)
+            options.showTiming = true;
+        else if (argv[i][0] == '-')
+            usage();
+        else
+        {
+            first = i;
+            break;
+        }
+    }
+    if (first == argc)
+        usage();
+
+    int server = connectTo(options.socketPath);
+    int exitCode = 0;
+    for (int i = first; i < argc; i++)
+    {
+        int result = runScript(&options, server, argv[i]);
+        if (exitCode == 0)
+            exitCode = result;
+    }
+    close(server);
+    return exitCode;
+}
@@ -4,15 +4,18 @@
 #include <string.h>
 
 #include "include/compiler.h"
+#include "include/array.h"
 #include "include/chunk.h"
 #include "include/scanner.h"
 #include "include/value.h"
 #include "include/object.h"
+#include "include/memory.h"
 #include "include/error.h"
+#include "include/stats.h"
+#include "include/probes.h"
+#include "include/number.h"
 
-#ifdef DEBUG_PRINT_CODE
 #include "include/debug.h"
-#endif
 
 // This is a Pratt parser
 
@@ -42,7 +45,7 @@ typedef enum
     PREC_PRIMARY
 } Precedence;
 
-typedef void (*ParseFn)(bool canAssign);
+typedef void (*ParseFn)(Parser *parser, bool canAssign);
 
 typedef struct
 {
@@ -51,182 +54,295 @@ typedef struct
     Precedence precedence;
 } ParseRule;
 
+/**
+ * @brief What the compiler knows about the type of a value at compile time
+ * There is no control flow yet, so the code runs in the order it is compiled and a forward
+ * pass is exact: a local has the type of whatever was last assigned to it. Globals can be
+ * defined by anything and stay unknown. Where both operands are TYPE_NUMBER the unchecked
+ * *_NUMBER opcodes are emitted, everything else keeps its runtime type test. Those opcodes work on
+ * doubles only: an int can overflow into a double at runtime, so integers are never more than
+ * TYPE_NUMERIC and keep the checked opcodes, which have an integer fast path of their own.
+ */
+typedef enum
+{
+    TYPE_UNKNOWN,
+    TYPE_NUMBER,  // a double
+    TYPE_NUMERIC, // a number of either kind
+    TYPE_STRING,
+    TYPE_BOOL,
+    TYPE_NIL,
+} StaticType;
+
 typedef struct
 {
     Token name;
     int depth;
+    StaticType type; // of the value the local holds right now
+    int shadowed;    // slot of the local with the same name this one hides, -1 if none, kept by the local index
 } Local;
 
-typedef struct
-{
-    Local locals[UINT8_COUNT];
-    int localCount; // traks how many array slots are in use in 'locals'
-    int scopeDepth; // number of blocks surrounding the current bit of code we're compiling
-} Compiler;
+#define LOCAL_INDEX_THRESHOLD 32 // locals that are still searched linearly, past them names are hashed
+#define LOCAL_EMPTY -1
+#define LOCAL_TOMBSTONE -2
 
-Parser parser = {
-    .hadError = false,
-    .panicMode = false,
+struct Compiler
+{
+    Local *locals;       // grown in the parser's arena, up to UINT16_COUNT
+    int localCount;      // traks how many array slots are in use in 'locals'
+    int localCapacity;
+    int *localIndex;     // open addressing from name to the innermost local's slot, NULL until needed
+    int localIndexCapacity;
+    int localIndexUsed;  // entries that are not LOCAL_EMPTY, tombstones included
+    int scopeDepth;      // number of blocks surrounding the current bit of code we're compiling
+    StaticType lastType; // type of the expression compiled last, its value is on top of the stack
 };
-Chunk *compilingChunk;
-Compiler *current = NULL;
 
-static Chunk *currentChunk()
+static Chunk *currentChunk(Parser *parser)
 {
-    return compilingChunk;
+    return parser->chunk;
 }
 
 /// @brief Function for stepping through a token stream, front end of the parser/compiler
-static void advance()
+static void advance(Parser *parser)
 {
-    parser.previous = parser.current;
+    parser->previous = parser->current;
 
     for (;;)
     {
-        parser.current = scanToken();
-        if (parser.current.type != TOKEN_ERROR)
+        parser->current = parser->tokens != NULL ? nextBufferedToken(parser->tokens) : scanToken(&parser->scanner);
+        if (parser->current.type != TOKEN_ERROR)
             break;
 
-        errorAtCurrentToken(parser.current.start);
+        errorAtCurrentToken(parser, parser->current.start);
     }
 }
 
 /// @brief Similar to check and match but does both thing in one function TODO: not needed?
-static void consume(TokenType type, const char *message)
+static void consume(Parser *parser, TokenType type, const char *message)
 {
-    if (parser.current.type == type)
+    if (parser->current.type == type)
     {
-        advance();
+        advance(parser);
         return;
     }
 
-    errorAtCurrentToken(message);
+    errorAtCurrentToken(parser, message);
 }
 
 /// @brief Thin helper for checking if `type` is the currently parsed token
-static bool check(TokenType type)
+static bool check(Parser *parser, TokenType type)
 {
-    return parser.current.type == type;
+    return parser->current.type == type;
 }
 
 /// @brief check if `type` is the currently parsed token,
 ///        if it is, advance passed it and return true, otherwise return false
-static bool match(TokenType type)
+static bool match(Parser *parser, TokenType type)
 {
-    if (!check(type))
+    if (!check(parser, type))
         return false;
-    advance();
+    advance(parser);
     return true;
 }
 
 // "emitByte" write byte to the currentChunk aka our compilingChunk
-static void emitByte(uint8_t byte)
+static void emitByte(Parser *parser, uint8_t byte)
 {
-    writeChunk(currentChunk(), byte, parser.previous.line);
+    writeChunk(parser->vm, currentChunk(parser), byte, parser->previous.line);
 }
 
 // Helper to emit 2 bytes with one function call instead of two
-static void emitBytes(uint8_t byte1, uint8_t byte2)
+static void emitBytes(Parser *parser, uint8_t byte1, uint8_t byte2)
+{
+    emitByte(parser, byte1);
+    emitByte(parser, byte2);
+}
+
+static void emitReturn(Parser *parser)
+{
+    emitByte(parser, OP_RETURN);
+}
+
+// Numbers compare by their bits, so 0 and -0 stay apart and a NaN finds itself
+static bool sameConstant(Value a, Value b)
+{
+    if (a.type != b.type)
+        return false;
+    switch (a.type)
+    {
+    case VAL_NUMBER:
+    {
+        double x = AS_NUMBER(a), y = AS_NUMBER(b);
+        return memcmp(&x, &y, sizeof(double)) == 0;
+    }
+    case VAL_INT:
+        return AS_INT(a) == AS_INT(b);
+    case VAL_OBJ:
+        return AS_OBJ(a) == AS_OBJ(b); // strings are interned
+    default:
+        return valuesEqual(a, b);
+    }
+}
+
+static uint32_t hashConstant(Value value)
 {
-    emitByte(byte1);
-    emitByte(byte2);
+    switch (value.type)
+    {
+    case VAL_NUMBER:
+    case VAL_INT:
+    {
+        // Both payloads are 8 bytes, an int and a double with the same bits just share a bucket
+        uint64_t bits;
+        memcpy(&bits, &value.as, sizeof(bits));
+        bits ^= bits >> 31;
+        bits *= 0x9e3779b97f4a7c15u;
+        return (uint32_t)(bits >> 32);
+    }
+    case VAL_OBJ:
+        return (uint32_t)((uintptr_t)AS_OBJ(value) >> 4);
+    case VAL_BOOL:
+        return AS_BOOL(value) ? 1 : 2;
+    default:
+        return 3;
+    }
 }
 
-static void emitReturn()
+// Slot of `value` in the constant index, either the one holding it or the empty one it goes in
+static int16_t *findConstant(Parser *parser, Value value)
 {
-    emitByte(OP_RETURN);
+    Value *constants = currentChunk(parser)->constants.values;
+    uint32_t index = hashConstant(value) & (CONSTANT_INDEX_SIZE - 1);
+    for (;;)
+    {
+        int16_t *slot = &parser->constantIndex[index];
+        if (*slot < 0 || sameConstant(constants[*slot], value))
+            return slot;
+        index = (index + 1) & (CONSTANT_INDEX_SIZE - 1);
+    }
 }
 
-// Add a value constant to the currentChunk()
-static uint8_t makeConstant(Value value)
+// Add a value constant to the currentChunk(), equal constants are shared
+static uint8_t makeConstant(Parser *parser, Value value)
 {
-    int constant = addConstant(currentChunk(), value);
+    int16_t *slot = findConstant(parser, value);
+    if (*slot >= 0)
+        return (uint8_t)*slot;
+
+    int constant = addConstant(parser->vm, currentChunk(parser), value);
     if (constant > UINT8_MAX)
     {
-        errorAtPreviousToken("Too many constants in one chunk.");
+        errorAtPreviousToken(parser, "Too many constants in one chunk.");
         return 0;
     }
 
+    *slot = (int16_t)constant;
     return (uint8_t)constant; // the index of the place the number is stored on the stack
 }
 
-static void emitConstant(Value value)
+static void emitConstant(Parser *parser, Value value)
 {
-    emitBytes(OP_CONSTANT, makeConstant(value));
+    emitBytes(parser, OP_CONSTANT, makeConstant(parser, value));
 }
 
-static void initCompiler(Compiler *compiler)
+static void initCompiler(Parser *parser, Compiler *compiler)
 {
+    compiler->locals = NULL;
     compiler->localCount = 0;
+    compiler->localCapacity = 0;
+    compiler->localIndex = NULL;
+    compiler->localIndexCapacity = 0;
+    compiler->localIndexUsed = 0;
     compiler->scopeDepth = 0;
-    current = compiler;
+    compiler->lastType = TYPE_UNKNOWN;
+    parser->compiler = compiler;
 }
 
-static void endCompiler()
+static void endCompiler(Parser *parser)
 {
-    emitReturn();
+    emitReturn(parser);
 
-#ifdef DEBUG_PRINT_CODE
-    if (!parser.hadError)
+    int offset;
+    const char *problem = parser->hadError ? NULL : prepareChunk(parser->vm, currentChunk(parser), &offset);
+    if (problem != NULL)
     {
-        dissassembleChunk(currentChunk(), "code");
+        // Bytecode the VM can't run safely is a compiler bug, never the users fault
+        fprintf(parser->vm->err, "Internal error: %s (bytecode offset %d)\n", problem, offset);
+        parser->hadError = true;
     }
-    else
+
+    if ((parser->vm->diagnostics & DIAG_DISASSEMBLE) && !parser->hadError)
     {
-        printf("Error");
+        dissassembleChunk(parser->vm->err, currentChunk(parser), "code");
+        if (currentChunk(parser)->registerCode != NULL)
+            dissassembleRegisterCode(parser->vm->err, currentChunk(parser), "register code");
     }
-#endif
 }
 
-static void beginScope()
+static void beginScope(Parser *parser)
 {
-    current->scopeDepth++;
+    parser->compiler->scopeDepth++;
 }
 
-static void endScope()
+static void unindexLocal(Compiler *compiler, int slot);
+
+static void endScope(Parser *parser)
 {
-    current->scopeDepth--;
+    parser->compiler->scopeDepth--;
 
     // Remove all locals from the ended scope
-    while (current->localCount > 0 &&
-           current->locals[current->localCount - 1].depth > current->scopeDepth)
+    while (parser->compiler->localCount > 0 &&
+           parser->compiler->locals[parser->compiler->localCount - 1].depth > parser->compiler->scopeDepth)
     {
-        current->localCount--;
-        emitByte(OP_POP); // OP_POPN?
+        parser->compiler->localCount--;
+        if (parser->compiler->localIndex != NULL)
+            unindexLocal(parser->compiler, parser->compiler->localCount);
+        emitByte(parser, OP_POP); // OP_POPN?
     }
 }
 
-static void expression();
-static void statement();
-static void decleration();
+static void expression(Parser *parser);
+static void statement(Parser *parser);
+static void decleration(Parser *parser);
 static ParseRule *getRule(TokenType type);
-static void parsePrecedence(Precedence precedence);
+static void parsePrecedence(Parser *parser, Precedence precedence);
 
-static void grouping(bool canAssign)
+static void grouping(Parser *parser, bool canAssign)
 {
-    expression(); // Recursive as heck
-    consume(TOKEN_RIGHT_PAREN, "Expect ')' after expression.");
+    expression(parser); // Recursive as heck
+    consume(parser, TOKEN_RIGHT_PAREN, "Expect ')' after expression.");
 }
 
 /*
  * To compile number literals we store a pointer to the following function at the TOKEN_NUMBE index in the array
  */
 
-static void number(bool canAssign)
+static void number(Parser *parser, bool canAssign)
 {
-    double value = strtold(parser.previous.start, NULL); // Converting char* to double here
-    emitConstant(NUMBER_VAL(value));
+    // The scanner only lets digits and one '.' into the token. Whole numbers that fit are
+    // integers, 1.0 and literals past INT64_MAX are doubles.
+    int64_t integer;
+    if (parseInteger(parser->previous.start, parser->previous.length, &integer))
+    {
+        emitConstant(parser, INT_VAL(integer));
+        parser->compiler->lastType = TYPE_NUMERIC;
+    }
+    else
+    {
+        emitConstant(parser, NUMBER_VAL(parseNumber(parser->previous.start, parser->previous.length)));
+        parser->compiler->lastType = TYPE_NUMBER;
+    }
 }
 
-static void string(bool canAssign)
+static void string(Parser *parser, bool canAssign)
 {
-    emitConstant(OBJ_VAL(copyString(parser.previous.start + 1,
-                                    parser.previous.length - 2)));
+    emitConstant(parser, OBJ_VAL(copyString(parser->vm, parser->previous.start + 1,
+                                            parser->previous.length - 2)));
+    parser->compiler->lastType = TYPE_STRING;
 }
 
-static uint8_t identifierConstant(Token *name)
+static uint8_t identifierConstant(Parser *parser, Token *name)
 {
-    return makeConstant(OBJ_VAL(copyString(name->start, name->length)));
+    return makeConstant(parser, OBJ_VAL(copyString(parser->vm, name->start, name->length)));
 }
 
 static bool identifierEqual(Token *a, Token *b)
@@ -236,61 +352,183 @@ static bool identifierEqual(Token *a, Token *b)
     return memcmp(a->start, b->start, a->length) == 0;
 }
 
+// FNV-1a, the same function the string table uses
+static uint32_t hashName(Token *name)
+{
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < name->length; i++)
+    {
+        hash ^= (uint8_t)name->start[i];
+        hash *= 16777619;
+    }
+    return hash;
+}
+
+// Entry of `name` in the local index, the one holding its innermost local or a free one it can go in
+static int *findLocalEntry(Compiler *compiler, Token *name)
+{
+    uint32_t mask = compiler->localIndexCapacity - 1;
+    uint32_t index = hashName(name) & mask;
+    int *tombstone = NULL;
+    for (;;)
+    {
+        int *entry = &compiler->localIndex[index];
+        if (*entry == LOCAL_EMPTY)
+            return tombstone != NULL ? tombstone : entry;
+        if (*entry == LOCAL_TOMBSTONE)
+        {
+            if (tombstone == NULL)
+                tombstone = entry;
+        }
+        else if (identifierEqual(name, &compiler->locals[*entry].name))
+        {
+            return entry;
+        }
+        index = (index + 1) & mask;
+    }
+}
+
+// Makes `slot` the innermost local of its name, the one it replaces is remembered as shadowed
+static void indexLocal(Compiler *compiler, int slot)
+{
+    int *entry = findLocalEntry(compiler, &compiler->locals[slot].name);
+    if (*entry == LOCAL_EMPTY)
+        compiler->localIndexUsed++;
+    compiler->locals[slot].shadowed = *entry >= 0 ? *entry : -1;
+    *entry = slot;
+}
+
+// Locals are popped innermost first, so the entry of a popped local points at it
+static void unindexLocal(Compiler *compiler, int slot)
+{
+    int *entry = findLocalEntry(compiler, &compiler->locals[slot].name);
+    int shadowed = compiler->locals[slot].shadowed;
+    *entry = shadowed >= 0 ? shadowed : LOCAL_TOMBSTONE;
+}
+
+// Indexes every local again, in a table at most a quarter full, which also drops the tombstones
+static void rebuildLocalIndex(Parser *parser)
+{
+    Compiler *compiler = parser->compiler;
+    int capacity = compiler->localIndexCapacity > 0 ? compiler->localIndexCapacity : LOCAL_INDEX_THRESHOLD * 4;
+    while (capacity < compiler->localCount * 4)
+        capacity *= 2;
+    if (capacity > compiler->localIndexCapacity)
+    {
+        compiler->localIndex = ARENA_ALLOCATE(&parser->arena, int, capacity);
+        compiler->localIndexCapacity = capacity;
+    }
+
+    memset(compiler->localIndex, 0xff, sizeof(int) * compiler->localIndexCapacity); // LOCAL_EMPTY
+    compiler->localIndexUsed = 0;
+    for (int slot = 0; slot < compiler->localCount; slot++)
+        indexLocal(compiler, slot);
+}
+
 // Given name of a local variable, returns the index of its position in the locals array, -1 if not found
-static int resolveLocal(Compiler *compiler, Token *name)
+static int resolveLocal(Parser *parser, Compiler *compiler, Token *name)
 {
-    for (int i = compiler->localCount - 1; i >= 0; i--)
+    int slot = -1;
+    if (compiler->localIndex != NULL)
+    {
+        int *entry = findLocalEntry(compiler, name);
+        slot = *entry >= 0 ? *entry : -1;
+    }
+    else
     {
-        Local *l = &compiler->locals[i];
-        if (identifierEqual(name, &l->name))
+        for (int i = compiler->localCount - 1; i >= 0 && slot == -1; i--)
         {
-            if (l->depth == -1)
-            {
-                errorAtCurrentToken("Can't resolve local variable in its own initalizer.");
-            }
-            return i;
+            if (identifierEqual(name, &compiler->locals[i].name))
+                slot = i;
         }
     }
 
-    return -1;
+    if (slot != -1 && compiler->locals[slot].depth == -1)
+    {
+        errorAtCurrentToken(parser, "Can't resolve local variable in its own initalizer.");
+    }
+    return slot;
 }
 
-static void addLocal(Token name)
+static void addLocal(Parser *parser, Token name)
 {
-    if (current->localCount >= UINT8_COUNT)
+    Compiler *compiler = parser->compiler;
+    if (compiler->localCount >= UINT16_COUNT)
     {
-        errorAtCurrentToken("Too many local variables in block.");
+        errorAtCurrentToken(parser, "Too many local variables in block.");
         return;
     }
-    Local *local = &current->locals[current->localCount++];
+    if (compiler->localCapacity < compiler->localCount + 1)
+    {
+        Local *locals = compiler->locals;
+        compiler->localCapacity = GROW_CAPACITY(compiler->localCapacity);
+        compiler->locals = ARENA_ALLOCATE(&parser->arena, Local, compiler->localCapacity);
+        if (compiler->localCount > 0)
+            memcpy(compiler->locals, locals, sizeof(Local) * compiler->localCount);
+    }
+
+    Local *local = &compiler->locals[compiler->localCount++];
     local->name = name;
     local->depth = -1;
+    local->type = TYPE_UNKNOWN;
+    local->shadowed = -1;
+
+    if (compiler->localIndex == NULL && compiler->localCount <= LOCAL_INDEX_THRESHOLD)
+        return;
+    if (compiler->localIndex == NULL || (compiler->localIndexUsed + 1) * 2 > compiler->localIndexCapacity)
+        rebuildLocalIndex(parser);
+    else
+        indexLocal(compiler, compiler->localCount - 1);
 }
 
-static void declareVariable()
+static void declareVariable(Parser *parser)
 {
-    if (current->scopeDepth == 0)
+    Compiler *compiler = parser->compiler;
+    if (compiler->scopeDepth == 0)
         return;
-    Token *name = &parser.previous;
-    for (int i = current->localCount - 1; i >= 0; i--)
+    Token *name = &parser->previous;
+    if (compiler->localIndex != NULL)
+    {
+        // Locals of the current scope are the innermost ones, so only the indexed one can clash
+        int *entry = findLocalEntry(compiler, name);
+        Local *otherLocal = *entry >= 0 ? &compiler->locals[*entry] : NULL;
+        if (otherLocal != NULL && (otherLocal->depth == -1 || otherLocal->depth >= compiler->scopeDepth))
+            errorAtCurrentToken(parser, "Already a variable with this name in scope.");
+        addLocal(parser, *name);
+        return;
+    }
+
+    for (int i = compiler->localCount - 1; i >= 0; i--)
     {
-        Local *otherLocal = &current->locals[i];
-        if (otherLocal->depth != -1 && otherLocal->depth < current->scopeDepth)
+        Local *otherLocal = &compiler->locals[i];
+        if (otherLocal->depth != -1 && otherLocal->depth < compiler->scopeDepth)
         {
             break;
         }
         if (identifierEqual(name, &otherLocal->name))
         {
-            errorAtCurrentToken("Already a variable with this name in scope.");
+            errorAtCurrentToken(parser, "Already a variable with this name in scope.");
         }
     }
-    addLocal(*name);
+    addLocal(parser, *name);
 }
 
-static void namedVariable(Token name, bool canAssign)
+// Slots past a byte take the *_LOCAL_LONG form of `op`
+static void emitLocal(Parser *parser, uint8_t op, int slot)
+{
+    if (slot <= UINT8_MAX)
+    {
+        emitBytes(parser, op, (uint8_t)slot);
+        return;
+    }
+    emitByte(parser, op == OP_GET_LOCAL ? OP_GET_LOCAL_LONG : OP_SET_LOCAL_LONG);
+    emitBytes(parser, (uint8_t)(slot >> 8), (uint8_t)slot);
+}
+
+static void namedVariable(Parser *parser, Token name, bool canAssign)
 {
     uint8_t getOp, setOp;
-    int arg = resolveLocal(current, &name);
+    int arg = resolveLocal(parser, parser->compiler, &name);
     if (arg != -1) // We have a local
     {
         getOp = OP_GET_LOCAL;
@@ -298,83 +536,95 @@ static void namedVariable(Token name, bool canAssign)
     }
     else
     {
-        arg = identifierConstant(&name);
+        arg = identifierConstant(parser, &name);
         getOp = OP_GET_GLOBAL;
         setOp = OP_SET_GLOBAL;
     }
 
-    if (canAssign && match(TOKEN_EQUAL))
+    if (canAssign && match(parser, TOKEN_EQUAL))
     {
-        expression(); // Evaluate the whole expression to the right of the equal
-        emitBytes(setOp, (uint8_t)arg);
+        expression(parser); // Evaluate the whole expression to the right of the equal
+        if (setOp == OP_SET_LOCAL)
+            emitLocal(parser, setOp, arg);
+        else
+            emitBytes(parser, setOp, (uint8_t)arg);
+        // The assignment evaluates to the assigned value, lastType already describes it
+        if (setOp == OP_SET_LOCAL)
+            parser->compiler->locals[arg].type = parser->compiler->lastType;
     }
     else
     {
-        emitBytes(getOp, (uint8_t)arg);
+        if (getOp == OP_GET_LOCAL)
+            emitLocal(parser, getOp, arg);
+        else
+            emitBytes(parser, getOp, (uint8_t)arg);
+        parser->compiler->lastType = getOp == OP_GET_LOCAL ? parser->compiler->locals[arg].type : TYPE_UNKNOWN;
     }
 }
 
-static void variable(bool canAssign)
+static void variable(Parser *parser, bool canAssign)
 {
-    namedVariable(parser.previous, canAssign);
+    namedVariable(parser, parser->previous, canAssign);
 }
 
-static void parsePrecedence(Precedence precedence)
+static void parsePrecedence(Parser *parser, Precedence precedence)
 {
-    advance();
-    ParseFn prefixRule = getRule(parser.previous.type)->prefix;
+    advance(parser);
+    ParseFn prefixRule = getRule(parser->previous.type)->prefix;
     if (prefixRule == NULL)
     {
-        errorAtCurrentToken("Expected expression");
+        errorAtCurrentToken(parser, "Expected expression");
         return;
     }
 
     // Is the left side (prefix) an assignable target?
     bool canAssign = precedence <= PREC_ASSIGNMENT;
-    prefixRule(canAssign);
+    prefixRule(parser, canAssign);
 
-    while (precedence <= getRule(parser.current.type)->precedence)
+    while (precedence <= getRule(parser->current.type)->precedence)
     {
-        advance();
-        ParseFn infixRule = getRule(parser.previous.type)->infix;
-        infixRule(canAssign);
+        advance(parser);
+        ParseFn infixRule = getRule(parser->previous.type)->infix;
+        infixRule(parser, canAssign);
     }
 
-    if (canAssign && match(TOKEN_EQUAL))
+    if (canAssign && match(parser, TOKEN_EQUAL))
     {
-        errorAtCurrentToken("Invalid assignment target");
+        errorAtCurrentToken(parser, "Invalid assignment target");
     }
 }
 
-static uint8_t parseVariable(const char *errorMessage)
+static uint8_t parseVariable(Parser *parser, const char *errorMessage)
 {
     // Requires the current token to be identifier, consume it
-    consume(TOKEN_IDENTIFIER, errorMessage);
+    consume(parser, TOKEN_IDENTIFIER, errorMessage);
 
-    declareVariable();
-    if (current->scopeDepth > 0)
+    declareVariable(parser);
+    if (parser->compiler->scopeDepth > 0)
         return 0;
 
-    return identifierConstant(&parser.previous); // from the previous token, make a constant and return its index
+    return identifierConstant(parser, &parser->previous); // from the previous token, make a constant and return its index
 }
 
-static void markInitalized()
+static void markInitalized(Parser *parser)
 {
-    current->locals[current->localCount - 1].depth = current->scopeDepth;
+    Local *local = &parser->compiler->locals[parser->compiler->localCount - 1];
+    local->depth = parser->compiler->scopeDepth;
+    local->type = parser->compiler->lastType; // the initializer's value is the local's slot
 }
 
-static void defineVariable(uint8_t global)
+static void defineVariable(Parser *parser, uint8_t global)
 {
-    if (current->scopeDepth > 0) // not in global scope?
+    if (parser->compiler->scopeDepth > 0) // not in global scope?
     {
-        markInitalized();
+        markInitalized(parser);
         return;
     }
     // Variable is stored in bytecode as as a OP_DEFINE_GLOBAL variable byte followed by the lookup index into the global variable table
-    emitBytes(OP_DEFINE_GLOBAL, global);
+    emitBytes(parser, OP_DEFINE_GLOBAL, global);
 }
 
-static void unary(bool canAssign)
+static void unary(Parser *parser, bool canAssign)
 {
     // Might seem weird to do expression and THEN emit the OP_NEGATE opcode but
     // it is part of the compilers job to take the source code (stream of tokens)
@@ -382,96 +632,294 @@ static void unary(bool canAssign)
     // Here, when we call expression it will leave the evaluate and put on top of stack
     // Then we pop that value, negate it and push the result.
 
-    TokenType operatorType = parser.previous.type;
+    TokenType operatorType = parser->previous.type;
 
     // Evaluate expression as UNARY precedence
-    parsePrecedence(PREC_UNARY);
+    parsePrecedence(parser, PREC_UNARY);
 
     // Emit the operator instruction
     switch (operatorType)
     {
     case TOKEN_BANG:
-        emitByte(OP_NOT);
+        emitByte(parser, OP_NOT);
+        parser->compiler->lastType = TYPE_BOOL;
         break;
     case TOKEN_MINUS:
-        emitByte(OP_NEGATE);
+        if (parser->compiler->lastType == TYPE_NUMBER)
+        {
+            emitByte(parser, OP_NEGATE_NUMBER);
+        }
+        else
+        {
+            emitByte(parser, OP_NEGATE);
+            parser->compiler->lastType = TYPE_NUMERIC; // or the check failed at runtime
+        }
         break;
     default:
         return; // Unreachable (syntatically)
     }
 }
 
+// The type a binary operator leaves behind, given it got past its runtime type test
+static StaticType binaryType(TokenType operatorType, StaticType left, StaticType right)
+{
+    switch (operatorType)
+    {
+    case TOKEN_PLUS:
+        // Numbers only add to numbers and strings only to strings
+        if (left == TYPE_NUMBER || right == TYPE_NUMBER)
+            return TYPE_NUMBER; // a double with any number is a double
+        if (left == TYPE_NUMERIC || right == TYPE_NUMERIC)
+            return TYPE_NUMERIC;
+        if (left == TYPE_STRING || right == TYPE_STRING)
+            return TYPE_STRING;
+        return TYPE_UNKNOWN;
+    case TOKEN_MINUS:
+    case TOKEN_STAR:
+    case TOKEN_SLASH:
+        return left == TYPE_NUMBER || right == TYPE_NUMBER ? TYPE_NUMBER : TYPE_NUMERIC;
+    default:
+        return TYPE_BOOL; // comparisons and equality
+    }
+}
+
 // Prefix parser function, leading token (constant) has already been consumed
-static void binary(bool canAssign)
+static void binary(Parser *parser, bool canAssign)
 {
-    TokenType operatorType = parser.previous.type;
+    TokenType operatorType = parser->previous.type;
+    StaticType left = parser->compiler->lastType;
     // This shall now consume the other part of the binary operation b of a op b
     ParseRule *rule = getRule(operatorType);
-    parsePrecedence((Precedence)(rule->precedence + 1));
+    parsePrecedence(parser, (Precedence)(rule->precedence + 1));
+    StaticType right = parser->compiler->lastType;
+    parser->compiler->lastType = binaryType(operatorType, left, right);
+
+    if (left == TYPE_NUMBER && right == TYPE_NUMBER)
+    {
+        switch (operatorType)
+        {
+        case TOKEN_GREATER:
+            emitByte(parser, OP_GREATER_NUMBER);
+            return;
+        case TOKEN_GREATER_EQUAL:
+            emitBytes(parser, OP_LESS_NUMBER, OP_NOT);
+            return;
+        case TOKEN_LESS:
+            emitByte(parser, OP_LESS_NUMBER);
+            return;
+        case TOKEN_LESS_EQUAL:
+            emitBytes(parser, OP_GREATER_NUMBER, OP_NOT);
+            return;
+        case TOKEN_PLUS:
+            emitByte(parser, OP_ADD_NUMBER);
+            return;
+        case TOKEN_MINUS:
+            emitByte(parser, OP_SUBTRACT_NUMBER);
+            return;
+        case TOKEN_STAR:
+            emitByte(parser, OP_MULTIPLY_NUMBER);
+            return;
+        case TOKEN_SLASH:
+            emitByte(parser, OP_DIVIDE_NUMBER);
+            return;
+        default:
+            break; // equality has no type test to skip
+        }
+    }
 
     switch (operatorType)
     {
     case TOKEN_BANG_EQUAL:
-        emitBytes(OP_EQUAL, OP_NOT);
+        emitBytes(parser, OP_EQUAL, OP_NOT);
         break;
         break;
     case TOKEN_EQUAL_EQUAL:
-        emitByte(OP_EQUAL);
+        emitByte(parser, OP_EQUAL);
         break;
     case TOKEN_GREATER:
-        emitByte(OP_GREATER);
+        emitByte(parser, OP_GREATER);
         break;
     case TOKEN_GREATER_EQUAL:
-        emitBytes(OP_LESS, OP_NOT);
+        emitBytes(parser, OP_LESS, OP_NOT);
         break;
     case TOKEN_LESS:
-        emitByte(OP_LESS);
+        emitByte(parser, OP_LESS);
         break;
     case TOKEN_LESS_EQUAL:
-        emitBytes(OP_GREATER, OP_NOT);
+        emitBytes(parser, OP_GREATER, OP_NOT);
         break;
     case TOKEN_PLUS:
-        emitByte(OP_ADD);
+        emitByte(parser, OP_ADD);
         break;
     case TOKEN_MINUS:
-        emitByte(OP_SUBTRACT);
+        emitByte(parser, OP_SUBTRACT);
         break;
     case TOKEN_STAR:
-        emitByte(OP_MULTIPLY);
+        emitByte(parser, OP_MULTIPLY);
         break;
     case TOKEN_SLASH:
-        emitByte(OP_DIVIDE);
+        emitByte(parser, OP_DIVIDE);
         break;
     default:
         return; // unreachable
     }
 }
 
-static void literal(bool canAssign)
+static void literal(Parser *parser, bool canAssign)
 {
-    switch (parser.previous.type)
+    switch (parser->previous.type)
     {
     case TOKEN_FALSE:
-        emitByte(OP_FALSE);
+        emitByte(parser, OP_FALSE);
+        parser->compiler->lastType = TYPE_BOOL;
         break;
     case TOKEN_NIL:
-        emitByte(OP_NIL);
+        emitByte(parser, OP_NIL);
+        parser->compiler->lastType = TYPE_NIL;
         break;
     case TOKEN_TRUE:
-        emitByte(OP_TRUE);
+        emitByte(parser, OP_TRUE);
+        parser->compiler->lastType = TYPE_BOOL;
         break;
     default:
         return; // unreachable lol
     }
 }
 
+// [a, b, c], the elements are converted to doubles when the array is built
+static void arrayLiteral(Parser *parser, bool canAssign)
+{
+    (void)canAssign; // `[..] = x` is an invalid assignment target, parsePrecedence reports it
+    int count = 0;
+    if (!check(parser, TOKEN_RIGHT_BRACKET))
+    {
+        do
+        {
+            expression(parser);
+            if (count == ARRAY_MAX_LITERAL)
+                errorAtPreviousToken(parser, "Can't have more than 255 elements in an array literal.");
+            count++;
+        } while (match(parser, TOKEN_COMMA));
+    }
+    consume(parser, TOKEN_RIGHT_BRACKET, "Expect ']' after array elements.");
+    emitBytes(parser, OP_ARRAY, (uint8_t)count);
+    parser->compiler->lastType = TYPE_UNKNOWN;
+}
+
+// {"key": value, ...}, keys are any expressions that evaluate to strings
+static void mapLiteral(Parser *parser, bool canAssign)
+{
+    (void)canAssign; // `{..} = x` is an invalid assignment target, parsePrecedence reports it
+    int count = 0;
+    if (!check(parser, TOKEN_RIGHT_BRACE))
+    {
+        do
+        {
+            expression(parser);
+            consume(parser, TOKEN_COLON, "Expect ':' after map key.");
+            expression(parser);
+            if (count == MAP_MAX_LITERAL)
+                errorAtPreviousToken(parser, "Can't have more than 255 entries in a map literal.");
+            count++;
+        } while (match(parser, TOKEN_COMMA));
+    }
+    consume(parser, TOKEN_RIGHT_BRACE, "Expect '}' after map entries.");
+    emitBytes(parser, OP_MAP, (uint8_t)count);
+    parser->compiler->lastType = TYPE_UNKNOWN;
+}
+
+// Infix `[`, the array or map is on the stack: array[index] or array[index] = value
+static void subscript(Parser *parser, bool canAssign)
+{
+    expression(parser);
+    consume(parser, TOKEN_RIGHT_BRACKET, "Expect ']' after index.");
+    if (canAssign && match(parser, TOKEN_EQUAL))
+    {
+        expression(parser);
+        emitByte(parser, OP_SET_INDEX); // evaluates to the assigned value, lastType describes it
+    }
+    else
+    {
+        emitByte(parser, OP_GET_INDEX);
+        parser->compiler->lastType = TYPE_UNKNOWN; // a double from an array, anything from a map
+    }
+}
+
+// The map methods, each takes a key: map.contains(key) and map.delete(key)
+static bool findMapMethod(Token *name, OpCode *op)
+{
+    if (name->length == 8 && memcmp(name->start, "contains", 8) == 0)
+        *op = OP_MAP_CONTAINS;
+    else if (name->length == 6 && memcmp(name->start, "delete", 6) == 0)
+        *op = OP_MAP_DELETE;
+    else
+        return false;
+    return true;
+}
+
+// Infix `.`, a call of a built-in array or map method, resolved by name right here
+static void dot(Parser *parser, bool canAssign)
+{
+    (void)canAssign; // `a.sum() = x` is an invalid assignment target, parsePrecedence reports it
+    consume(parser, TOKEN_IDENTIFIER, "Expect method name after '.'.");
+    Token name = parser->previous;
+    ArrayMethod method = ARRAY_LENGTH;
+    OpCode mapMethod;
+    bool isMapMethod = findMapMethod(&name, &mapMethod);
+    bool known = isMapMethod || findArrayMethod(name.start, name.length, &method);
+    if (!known)
+        errorAtPreviousToken(parser, "Arrays and maps have no method of that name.");
+
+    consume(parser, TOKEN_LEFT_PAREN, "Expect '(' after method name.");
+    int arguments = 0;
+    if (!check(parser, TOKEN_RIGHT_PAREN))
+    {
+        do
+        {
+            expression(parser);
+            arguments++;
+        } while (match(parser, TOKEN_COMMA));
+    }
+    consume(parser, TOKEN_RIGHT_PAREN, "Expect ')' after arguments.");
+
+    bool binary = isMapMethod || method >= ARRAY_FIRST_BINARY;
+    if (known && arguments != (binary ? 1 : 0))
+        errorAtPreviousToken(parser, binary ? "Method takes one argument." : "Method takes no arguments.");
+    if (isMapMethod)
+    {
+        emitByte(parser, mapMethod);
+        parser->compiler->lastType = TYPE_BOOL;
+        return;
+    }
+    emitBytes(parser, binary ? OP_ARRAY_BINARY : OP_ARRAY_UNARY, (uint8_t)method);
+
+    switch (method)
+    {
+    case ARRAY_LENGTH:
+        parser->compiler->lastType = TYPE_NUMERIC;
+        break;
+    case ARRAY_SUM:
+    case ARRAY_MIN:
+    case ARRAY_MAX:
+    case ARRAY_DOT:
+        parser->compiler->lastType = TYPE_NUMBER;
+        break;
+    default:
+        parser->compiler->lastType = TYPE_UNKNOWN; // an array
+        break;
+    }
+}
+
 ParseRule rules[] = {
     [TOKEN_LEFT_PAREN] = {grouping, NULL, PREC_NONE},
     [TOKEN_RIGHT_PAREN] = {NULL, NULL, PREC_NONE},
-    [TOKEN_LEFT_BRACE] = {NULL, NULL, PREC_NONE},
+    [TOKEN_LEFT_BRACE] = {mapLiteral, NULL, PREC_NONE},
     [TOKEN_RIGHT_BRACE] = {NULL, NULL, PREC_NONE},
+    [TOKEN_LEFT_BRACKET] = {arrayLiteral, subscript, PREC_CALL},
+    [TOKEN_RIGHT_BRACKET] = {NULL, NULL, PREC_NONE},
     [TOKEN_COMMA] = {NULL, NULL, PREC_NONE},
-    [TOKEN_DOT] = {NULL, NULL, PREC_NONE},
+    [TOKEN_DOT] = {NULL, dot, PREC_CALL},
+    [TOKEN_COLON] = {NULL, NULL, PREC_NONE},
     [TOKEN_MINUS] = {unary, binary, PREC_TERM},
     [TOKEN_PLUS] = {NULL, binary, PREC_TERM},
     [TOKEN_SEMICOLON] = {NULL, NULL, PREC_NONE},
@@ -513,66 +961,67 @@ static ParseRule *getRule(TokenType type)
     return &rules[type];
 }
 
-static void expression()
+static void expression(Parser *parser)
 {
-    parsePrecedence(PREC_ASSIGNMENT); // we call into parsing with the lowest precedence level
+    parsePrecedence(parser, PREC_ASSIGNMENT); // we call into parsing with the lowest precedence level
 }
 
-static void block()
+static void block(Parser *parser)
 {
-    while (!check(TOKEN_RIGHT_BRACE) && !check(TOKEN_EOF))
+    while (!check(parser, TOKEN_RIGHT_BRACE) && !check(parser, TOKEN_EOF))
     {
-        decleration();
+        decleration(parser);
     }
 
-    consume(TOKEN_RIGHT_BRACE, "Expecteed '}' after block statement.");
+    consume(parser, TOKEN_RIGHT_BRACE, "Expecteed '}' after block statement.");
 }
 
-static void varDecleration()
+static void varDecleration(Parser *parser)
 {
     // Consumes identifier token for the var name
     // adds it lexeme to the chunk's constant table as a string
     // and then returns the constant table index where it was added
-    uint8_t globalIndex = parseVariable("Expect variable name.");
+    uint8_t globalIndex = parseVariable(parser, "Expect variable name.");
 
-    if (match(TOKEN_EQUAL))
+    if (match(parser, TOKEN_EQUAL))
     {
-        expression(); // This should emit the actuallu initalization value
+        expression(parser); // This should emit the actuallu initalization value
     }
     else // desugars var a; into var a = nil;
     {
-        emitByte(OP_NIL);
+        emitByte(parser, OP_NIL);
+        parser->compiler->lastType = TYPE_NIL;
     }
 
     // emit the bytecode for storing the variable's value in the global variables hash table
-    consume(TOKEN_SEMICOLON, "Expect ';' after variable declaration");
-    defineVariable(globalIndex);
+    consume(parser, TOKEN_SEMICOLON, "Expect ';' after variable declaration");
+    defineVariable(parser, globalIndex);
 }
 
-static void expressionStatement()
+static void expressionStatement(Parser *parser)
 {
-    expression();
-    consume(TOKEN_SEMICOLON, "Expect ';' after expression.");
-    emitByte(OP_POP);
+    expression(parser);
+    consume(parser, TOKEN_SEMICOLON, "Expect ';' after expression.");
+    emitByte(parser, OP_POP);
 }
 
-static void printStatement()
+static void printStatement(Parser *parser)
 {
-    expression(); // Evaluate an expression then emit a OP_PRINT
-    consume(TOKEN_SEMICOLON, "Expect ';' after value.");
-    emitByte(OP_PRINT); // The expression should have produced some sort of Value on the stack we can print!
+    expression(parser); // Evaluate an expression then emit a OP_PRINT
+    consume(parser, TOKEN_SEMICOLON, "Expect ';' after value.");
+    emitByte(parser, OP_PRINT); // The expression should have produced some sort of Value on the stack we can print!
 }
 
-static void synchronize()
+static void synchronize(Parser *parser)
 {
-    parser.panicMode = false;
-    while (parser.current.type != TOKEN_EOF)
+    parser->panicMode = false;
+    while (parser->current.type != TOKEN_EOF)
     {
         // We indescrimentally skip tokens until we reach something that looks like the end of a statement (semicolon)
         // Or until we reach something that looks like the beggining of a new statement. Usually a variable decleration or control flow keyword
-        if (parser.previous.type == TOKEN_SEMICOLON)
+        if (parser->previous.type == TOKEN_SEMICOLON)
             return;
-        switch (parser.current.type)
+        switch (parser->current.type)
         {
         case TOKEN_CLASS:
         case TOKEN_PROC:
@@ -586,61 +1035,93 @@ static void synchronize()
         default:; // Do nohting
         }
 
-        advance();
+        advance(parser);
     }
 }
 
-static void decleration()
+static void decleration(Parser *parser)
 {
-    if (match(TOKEN_DAT))
+    if (match(parser, TOKEN_DAT))
     {
-        varDecleration();
+        varDecleration(parser);
     }
     else
     {
-        statement();
+        statement(parser);
     }
 
-    if (parser.panicMode)
-        synchronize();
+    if (parser->panicMode)
+        synchronize(parser);
 }
 
-static void statement()
+static void statement(Parser *parser)
 {
     // Statement is either a print or a decleration
-    if (match(TOKEN_PRINT))
+    if (match(parser, TOKEN_PRINT))
     {
-        printStatement();
+        printStatement(parser);
     }
-    else if (match(TOKEN_LEFT_BRACE))
+    else if (match(parser, TOKEN_LEFT_BRACE))
     {
-        beginScope(); // {
-        block();      // ...kråd..
-        endScope();   // }
+        beginScope(parser); // {
+        block(parser);      // ...kråd..
+        endScope(parser);   // }
     }
     else
     {
-        expressionStatement();
+        expressionStatement(parser);
     }
 }
 
-bool compile(const char *source, Chunk *chunk)
+bool compile(VM *vm, const char *source, Chunk *chunk)
 {
-    initScanner(source);
+    PROBE_COMPILE_START(source, strlen(source));
+    int start = chunk->count, constantStart = chunk->constants.count; // a session appends to a chunk
+    Parser parser = {0}; // allocations before the first token are attributed to line 0, not to garbage
+    initScanner(&parser.scanner, source);
+    TokenBuffer tokens;
+    parser.tokens = vm->lexJobs != 1 && lexParallel(&tokens, source, vm->lexJobs) ? &tokens : NULL;
+    parser.hadError = false;
+    parser.panicMode = false;
+    parser.vm = vm;
+    parser.chunk = chunk; // Pointer to the chunk of bytecode we are compiling TO
     Compiler compiler;
-    initCompiler(&compiler);
-    compilingChunk = chunk; // Pointer to the chunk of bytecode we are compiling TO
+    initCompiler(&parser, &compiler);
+    vm->parser = &parser;
+
+    // A session appends to a chunk, its constants are shared with the new code too
+    initArena(&parser.arena, vm);
+    parser.constantIndex = ARENA_ALLOCATE(&parser.arena, int16_t, CONSTANT_INDEX_SIZE);
+    memset(parser.constantIndex, -1, sizeof(int16_t) * CONSTANT_INDEX_SIZE);
+    for (int i = 0; i < chunk->constants.count; i++)
+        *findConstant(&parser, chunk->constants.values[i]) = (int16_t)i;
+    Obj *objectsBefore = vm->objects;
 
-    advance();
+    advance(&parser);
 
     // -> this wwas when we did only 1 expression! expression();
-    while (!match(TOKEN_EOF)) // a program is a sequence of declerations
+    while (!match(&parser, TOKEN_EOF)) // a program is a sequence of declerations
     {
-        decleration();
+        decleration(&parser);
     }
 
-    consume(TOKEN_EOF, "Expect end of expression.");
+    consume(&parser, TOKEN_EOF, "Expect end of expression.");
+
+    endCompiler(&parser);
+    freeArena(&parser.arena);
+    if (parser.tokens != NULL)
+        freeTokenBuffer(parser.tokens);
+    vm->parser = NULL;
+
+    // Nothing but the discarded chunk refers to strings made by a failed compile
+    if (parser.hadError)
+        freeObjectsSince(vm, objectsBefore);
 
-    endCompiler();
+    STAT_INC(vm, chunksCompiled);
+    STAT_ADD(vm, chunkBytes, chunk->count - start);
+    STAT_MAX(vm, chunkBytesMax, chunk->count);
+    STAT_ADD(vm, chunkConstants, chunk->constants.count - constantStart);
+    STAT_MAX(vm, chunkConstantsMax, chunk->constants.count);
+    PROBE_COMPILE_DONE(!parser.hadError, chunk->count, chunk->constants.count);
     return !parser.hadError;
 }
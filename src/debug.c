@@ -1,99 +1,339 @@
 #include <stdio.h>
+#include <string.h>
+#include <unistd.h>
 
+#include "include/array.h"
 #include "include/debug.h"
+#include "include/object.h"
 #include "include/value.h"
 
-void dissassembleChunk(Chunk *chunk, const char *name)
+void dissassembleChunk(FILE *out, Chunk *chunk, const char *name)
 {
-    printf("== %s == \n", name);
+    fprintf(out, "== %s == \n", name);
 
     for (int offset = 0; offset < chunk->count;)
     {
-        offset = dissassembleInstruction(chunk, offset);
+        offset = dissassembleInstruction(out, chunk, offset);
     }
 }
 
-static int simpleInstruction(const char *name, int offset)
+void dissassembleInstructions(FILE *out, Chunk *chunk, const char *name)
 {
-    printf("%s\n", name);
+    fprintf(out, "== %s (%d records) == \n", name, chunk->instructionCount);
+
+    for (int i = 0; i < chunk->instructionCount; i++)
+    {
+        fprintf(out, "[%4d] ", i);
+        dissassembleInstruction(out, chunk, chunk->instructions[i].offset);
+    }
+}
+
+static const char *registerOpNames[] = {
+    [REG_MOVE] = "REG_MOVE",
+    [REG_NOT] = "REG_NOT",
+    [REG_NEGATE] = "REG_NEGATE",
+    [REG_NEGATE_NUMBER] = "REG_NEGATE_NUMBER",
+    [REG_ADD] = "REG_ADD",
+    [REG_SUBTRACT] = "REG_SUBTRACT",
+    [REG_MULTIPLY] = "REG_MULTIPLY",
+    [REG_DIVIDE] = "REG_DIVIDE",
+    [REG_EQUAL] = "REG_EQUAL",
+    [REG_GREATER] = "REG_GREATER",
+    [REG_LESS] = "REG_LESS",
+    [REG_ADD_NUMBER] = "REG_ADD_NUMBER",
+    [REG_SUBTRACT_NUMBER] = "REG_SUBTRACT_NUMBER",
+    [REG_MULTIPLY_NUMBER] = "REG_MULTIPLY_NUMBER",
+    [REG_DIVIDE_NUMBER] = "REG_DIVIDE_NUMBER",
+    [REG_GREATER_NUMBER] = "REG_GREATER_NUMBER",
+    [REG_LESS_NUMBER] = "REG_LESS_NUMBER",
+    [REG_ARRAY] = "REG_ARRAY",
+    [REG_GET_INDEX] = "REG_GET_INDEX",
+    [REG_SET_INDEX] = "REG_SET_INDEX",
+    [REG_ARRAY_UNARY] = "REG_ARRAY_UNARY",
+    [REG_ARRAY_BINARY] = "REG_ARRAY_BINARY",
+    [REG_MAP] = "REG_MAP",
+    [REG_MAP_CONTAINS] = "REG_MAP_CONTAINS",
+    [REG_MAP_DELETE] = "REG_MAP_DELETE",
+    [REG_DEFINE_GLOBAL] = "REG_DEFINE_GLOBAL",
+    [REG_GET_GLOBAL] = "REG_GET_GLOBAL",
+    [REG_SET_GLOBAL] = "REG_SET_GLOBAL",
+    [REG_PRINT] = "REG_PRINT",
+    [REG_RETURN] = "REG_RETURN",
+};
+
+// Stack slot registers print as r<n>, the preloaded ones as the value they hold
+static void printRegister(FILE *out, Chunk *chunk, int reg)
+{
+    int preloaded = reg - chunk->registerSlots;
+    if (preloaded < 0)
+    {
+        fprintf(out, " r%d", reg);
+    }
+    else if (preloaded < 3)
+    {
+        fprintf(out, " %s", preloaded == 0 ? "nil" : preloaded == 1 ? "true" : "false");
+    }
+    else
+    {
+        fprintf(out, " '");
+        printDebugValue(out, chunk->constants.values[preloaded - 3]);
+        fprintf(out, "'");
+    }
+}
+
+void dissassembleRegisterInstruction(FILE *out, Chunk *chunk, RegInstr *instr)
+{
+    fprintf(out, "%04d %4d %-20s", instr->offset, chunk->lines[instr->offset], registerOpNames[instr->op]);
+    switch (instr->op)
+    {
+    case REG_RETURN:
+        break;
+    case REG_PRINT:
+        printRegister(out, chunk, instr->b);
+        break;
+    case REG_GET_GLOBAL:
+        printRegister(out, chunk, instr->a);
+        fprintf(out, " %s", instr->as.name->chars);
+        break;
+    case REG_DEFINE_GLOBAL:
+    case REG_SET_GLOBAL:
+        fprintf(out, " %s", instr->as.name->chars);
+        printRegister(out, chunk, instr->b);
+        break;
+    case REG_ARRAY:
+    case REG_MAP:
+        printRegister(out, chunk, instr->a);
+        fprintf(out, " %d from r%d", instr->as.c, instr->b);
+        break;
+    case REG_ARRAY_UNARY:
+        printRegister(out, chunk, instr->a);
+        printRegister(out, chunk, instr->b);
+        fprintf(out, " %s", arrayMethodName(instr->method));
+        break;
+    case REG_ARRAY_BINARY:
+        printRegister(out, chunk, instr->a);
+        printRegister(out, chunk, instr->b);
+        printRegister(out, chunk, instr->as.c);
+        fprintf(out, " %s", arrayMethodName(instr->method));
+        break;
+    case REG_MOVE:
+    case REG_NOT:
+    case REG_NEGATE:
+    case REG_NEGATE_NUMBER:
+        printRegister(out, chunk, instr->a);
+        printRegister(out, chunk, instr->b);
+        break;
+    default:
+        printRegister(out, chunk, instr->a);
+        printRegister(out, chunk, instr->b);
+        printRegister(out, chunk, instr->as.c);
+        break;
+    }
+    fprintf(out, "\n");
+}
+
+void dissassembleRegisterCode(FILE *out, Chunk *chunk, const char *name)
+{
+    fprintf(out, "== %s (%d instructions, %d registers) == \n", name, chunk->registerCodeCount, chunk->registerCount);
+
+    for (int i = 0; i < chunk->registerCodeCount; i++)
+    {
+        dissassembleRegisterInstruction(out, chunk, &chunk->registerCode[i]);
+    }
+}
+
+void dumpStack(FILE *out, Value *bottom, Value *top)
+{
+    fprintf(out, "       ");
+    for (Value *slot = bottom; slot < top; slot++)
+    {
+        fprintf(out, "[ ");
+        printDebugValue(out, *slot);
+        fprintf(out, " ]");
+    }
+    fprintf(out, "\n");
+}
+
+// Output sink that hands printValue's bytes to a stdio stream
+static bool writeToFile(void *context, const char *bytes, size_t length)
+{
+    return fwrite(bytes, 1, length, (FILE *)context) == length;
+}
+
+void printDebugValue(FILE *out, Value value)
+{
+    char buffer[256];
+    Output output;
+    initOutput(&output, STDOUT_FILENO, sizeof(buffer), OUTPUT_FLUSH_FULL);
+    output.buffer = buffer; // Small and short-lived, no need for the heap
+    setOutputSink(&output, writeToFile, out);
+    printValue(&output, value);
+    flushOutput(&output);
+}
+
+bool parseDiagnostics(const char *list, int *diagnostics)
+{
+    static const struct
+    {
+        const char *name;
+        int flag;
+    } names[] = {
+        {"disassemble", DIAG_DISASSEMBLE},
+        {"trace", DIAG_TRACE},
+        {"stack", DIAG_STACK},
+    };
+
+    *diagnostics = 0;
+    while (*list != '\0')
+    {
+        size_t length = strcspn(list, ",");
+        bool known = length == 0;
+        for (size_t i = 0; i < sizeof(names) / sizeof(names[0]) && !known; i++)
+        {
+            if (strlen(names[i].name) == length && strncmp(list, names[i].name, length) == 0)
+            {
+                *diagnostics |= names[i].flag;
+                known = true;
+            }
+        }
+        if (!known)
+            return false;
+        list += length;
+        if (*list == ',')
+            list++;
+    }
+    return true;
+}
+
+static int simpleInstruction(FILE *out, const char *name, int offset)
+{
+    fprintf(out, "%s\n", name);
     return offset + 1;
 }
 
-static int constantInstruction(const char *name, Chunk *chunk, int offset)
+static int constantInstruction(FILE *out, const char *name, Chunk *chunk, int offset)
 {
     uint8_t constant = chunk->code[offset + 1];
-    printf("%-16s %4d '", name, constant);
-    printValue(chunk->constants.values[constant]);
-    printf("'\n");
+    fprintf(out, "%-16s %4d '", name, constant);
+    printDebugValue(out, chunk->constants.values[constant]);
+    fprintf(out, "'\n");
     return offset + 2;
 }
 
-static int byteInstruction(const char *name, Chunk *chunk, int offset)
+static int byteInstruction(FILE *out, const char *name, Chunk *chunk, int offset)
 {
     uint8_t slot = chunk->code[offset + 1];
-    printf("%-16s %4d\n", name, slot);
+    fprintf(out, "%-16s %4d\n", name, slot);
     return offset + 2;
 }
 
-int dissassembleInstruction(Chunk *chunk, int offset)
+static int methodInstruction(FILE *out, const char *name, Chunk *chunk, int offset)
+{
+    uint8_t method = chunk->code[offset + 1];
+    fprintf(out, "%-16s %4d %s\n", name, method, method < ARRAY_METHOD_COUNT ? arrayMethodName(method) : "?");
+    return offset + 2;
+}
+
+static int shortInstruction(FILE *out, const char *name, Chunk *chunk, int offset)
+{
+    int slot = chunk->code[offset + 1] << 8 | chunk->code[offset + 2];
+    fprintf(out, "%-16s %4d\n", name, slot);
+    return offset + 3;
+}
+
+int dissassembleInstruction(FILE *out, Chunk *chunk, int offset)
 {
-    printf("%04d ", offset);
+    fprintf(out, "%04d ", offset);
     if (offset > 0 && chunk->lines[offset] == chunk->lines[offset - 1])
     {
-        printf("   | ");
+        fprintf(out, "   | ");
     }
     else
     {
-        printf("%4d ", chunk->lines[offset]);
+        fprintf(out, "%4d ", chunk->lines[offset]);
     }
 
     uint8_t instruction = chunk->code[offset];
     switch (instruction)
     {
     case OP_RETURN:
-        return simpleInstruction("OP_RETURN", offset);
+        return simpleInstruction(out, "OP_RETURN", offset);
     case OP_CONSTANT:
-        return constantInstruction("OP_CONSTANT", chunk, offset);
+        return constantInstruction(out, "OP_CONSTANT", chunk, offset);
     case OP_NIL:
-        return simpleInstruction("OP_NIL", offset);
+        return simpleInstruction(out, "OP_NIL", offset);
     case OP_NOT:
-        return simpleInstruction("OP_NOT", offset);
+        return simpleInstruction(out, "OP_NOT", offset);
     case OP_TRUE:
-        return simpleInstruction("OP_TRUE", offset);
+        return simpleInstruction(out, "OP_TRUE", offset);
     case OP_FALSE:
-        return simpleInstruction("OP_FALSE", offset);
+        return simpleInstruction(out, "OP_FALSE", offset);
     case OP_EQUAL:
-        return simpleInstruction("OP_EQUAL", offset);
+        return simpleInstruction(out, "OP_EQUAL", offset);
     case OP_SET_GLOBAL:
-        return constantInstruction("OP_SET_GLOBAL", chunk, offset);
+        return constantInstruction(out, "OP_SET_GLOBAL", chunk, offset);
     case OP_POP:
-        return simpleInstruction("OP_POP", offset);
+        return simpleInstruction(out, "OP_POP", offset);
     case OP_GET_LOCAL:
-        return byteInstruction("OP_GET_LOCAL", chunk, offset);
+        return byteInstruction(out, "OP_GET_LOCAL", chunk, offset);
     case OP_SET_LOCAL:
-        return byteInstruction("OP_SET_LOCAL", chunk, offset);
+        return byteInstruction(out, "OP_SET_LOCAL", chunk, offset);
     case OP_GET_GLOBAL:
-        return constantInstruction("OP_GET_GLOBAL", chunk, offset);
+        return constantInstruction(out, "OP_GET_GLOBAL", chunk, offset);
     case OP_DEFINE_GLOBAL:
-        return constantInstruction("OP_DEFINE_GLOBAL", chunk, offset);
+        return constantInstruction(out, "OP_DEFINE_GLOBAL", chunk, offset);
     case OP_GREATER:
-        return simpleInstruction("OP_GREATER", offset);
+        return simpleInstruction(out, "OP_GREATER", offset);
     case OP_LESS:
-        return simpleInstruction("OP_LESS", offset);
+        return simpleInstruction(out, "OP_LESS", offset);
     case OP_NEGATE:
-        return simpleInstruction("OP_NEGATE", offset);
+        return simpleInstruction(out, "OP_NEGATE", offset);
     case OP_ADD:
-        return simpleInstruction("OP_ADD", offset);
+        return simpleInstruction(out, "OP_ADD", offset);
     case OP_SUBTRACT:
-        return simpleInstruction("OP_SUBTRACT", offset);
+        return simpleInstruction(out, "OP_SUBTRACT", offset);
     case OP_MULTIPLY:
-        return simpleInstruction("OP_MULTIPLY", offset);
+        return simpleInstruction(out, "OP_MULTIPLY", offset);
     case OP_DIVIDE:
-        return simpleInstruction("OP_DIVIDE", offset);
+        return simpleInstruction(out, "OP_DIVIDE", offset);
     case OP_PRINT:
-        return simpleInstruction("OP_PRINT", offset);
+        return simpleInstruction(out, "OP_PRINT", offset);
+    case OP_NEGATE_NUMBER:
+        return simpleInstruction(out, "OP_NEGATE_NUMBER", offset);
+    case OP_ADD_NUMBER:
+        return simpleInstruction(out, "OP_ADD_NUMBER", offset);
+    case OP_SUBTRACT_NUMBER:
+        return simpleInstruction(out, "OP_SUBTRACT_NUMBER", offset);
+    case OP_MULTIPLY_NUMBER:
+        return simpleInstruction(out, "OP_MULTIPLY_NUMBER", offset);
+    case OP_DIVIDE_NUMBER:
+        return simpleInstruction(out, "OP_DIVIDE_NUMBER", offset);
+    case OP_GREATER_NUMBER:
+        return simpleInstruction(out, "OP_GREATER_NUMBER", offset);
+    case OP_LESS_NUMBER:
+        return simpleInstruction(out, "OP_LESS_NUMBER", offset);
+    case OP_GET_LOCAL_LONG:
+        return shortInstruction(out, "OP_GET_LOCAL_LONG", chunk, offset);
+    case OP_SET_LOCAL_LONG:
+        return shortInstruction(out, "OP_SET_LOCAL_LONG", chunk, offset);
+    case OP_ARRAY:
+        return byteInstruction(out, "OP_ARRAY", chunk, offset);
+    case OP_GET_INDEX:
+        return simpleInstruction(out, "OP_GET_INDEX", offset);
+    case OP_SET_INDEX:
+        return simpleInstruction(out, "OP_SET_INDEX", offset);
+    case OP_ARRAY_UNARY:
+        return methodInstruction(out, "OP_ARRAY_UNARY", chunk, offset);
+    case OP_ARRAY_BINARY:
+        return methodInstruction(out, "OP_ARRAY_BINARY", chunk, offset);
+    case OP_MAP:
+        return byteInstruction(out, "OP_MAP", chunk, offset);
+    case OP_MAP_CONTAINS:
+        return simpleInstruction(out, "OP_MAP_CONTAINS", offset);
+    case OP_MAP_DELETE:
+        return simpleInstruction(out, "OP_MAP_DELETE", offset);
     default:
-        printf("Unknown opcode %d\n", instruction);
+        fprintf(out, "Unknown opcode %d\n", instruction);
         return offset + 1;
     }
 }
@@ -5,16 +5,17 @@
 
 #include <stdio.h>
 
-static void errorAt(Token *token, const char *message)
+static void errorAt(Parser *parser, Token *token, const char *message)
 {
-    if (parser.panicMode)
+    if (parser->panicMode)
         return;
-    parser.panicMode = true;
-    fprintf(stderr, "[line %d] Error", token->line);
+    parser->panicMode = true;
+    FILE *err = parser->vm->err;
+    fprintf(err, "[line %d] Error", token->line);
 
     if (token->type == TOKEN_EOF)
     {
-        fprintf(stderr, " at end");
+        fprintf(err, " at end");
     }
     else if (token->type == TOKEN_ERROR)
     {
@@ -22,19 +23,19 @@ static void errorAt(Token *token, const char *message)
     }
     else
     {
-        fprintf(stderr, " at '%.*s' ", token->length, token->start);
+        fprintf(err, " at '%.*s' ", token->length, token->start);
     }
 
-    fprintf(stderr, ": %s\n", message);
-    parser.hadError = true;
+    fprintf(err, ": %s\n", message);
+    parser->hadError = true;
 }
 
-void errorAtCurrentToken(const char *message)
+void errorAtCurrentToken(Parser *parser, const char *message)
 {
-    errorAt(&parser.current, message);
+    errorAt(parser, &parser->current, message);
 }
 
-void errorAtPreviousToken(const char *message)
+void errorAtPreviousToken(Parser *parser, const char *message)
 {
-    errorAt(&parser.previous, message);
+    errorAt(parser, &parser->previous, message);
 }
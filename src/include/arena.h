@@ -0,0 +1,31 @@
+#ifndef slorp_arena_h
+#define slorp_arena_h
+
+#include <stddef.h>
+
+typedef struct VM VM;
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+typedef struct ArenaBlock ArenaBlock;
+
+/**
+ * @brief Bump pointer allocator for data that lives exactly as long as one compile or prepare
+ * Allocations are carved from blocks in order and never freed one by one, freeArena releases
+ * every block at once. The blocks are accounted to `vm` like any other allocation.
+ */
+typedef struct
+{
+    VM *vm;
+    ArenaBlock *blocks; // newest first, allocations come from the head
+} Arena;
+
+void initArena(Arena *arena, VM *vm);
+void freeArena(Arena *arena);
+
+// Uninitialized memory aligned for any type, valid until freeArena
+void *arenaAlloc(Arena *arena, size_t size);
+
+#define ARENA_ALLOCATE(arena, type, count) ((type *)arenaAlloc(arena, sizeof(type) * (count)))
+
+#endif
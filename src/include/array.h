@@ -0,0 +1,49 @@
+#ifndef slorp_array_h
+#define slorp_array_h
+
+#include <stdbool.h>
+
+/**
+ * @brief The built-in methods of arrays, `values.sum()`, `a.dot(b)`
+ * Resolved by name at compile time into the operand of OP_ARRAY_UNARY (the methods without an
+ * argument, listed first) or OP_ARRAY_BINARY (the methods taking one).
+ */
+typedef enum
+{
+    ARRAY_LENGTH, // count of elements, an int
+    ARRAY_SUM,
+    ARRAY_MIN,
+    ARRAY_MAX,
+    ARRAY_DOT,   // sum of the products of two arrays of the same length
+    ARRAY_ADD,   // element-wise sum, a new array
+    ARRAY_MUL,   // element-wise product, a new array
+    ARRAY_SCALE, // every element times a number, a new array
+} ArrayMethod;
+
+#define ARRAY_METHOD_COUNT (ARRAY_SCALE + 1)
+#define ARRAY_FIRST_BINARY ARRAY_DOT
+
+#define ARRAY_MAX_LITERAL 255 // elements of an array literal, one operand byte
+
+const char *arrayMethodName(ArrayMethod method);
+
+// The method called `name`, false if arrays have none by that name
+bool findArrayMethod(const char *name, int length, ArrayMethod *method);
+
+/**
+ * @brief Bulk kernels over packed doubles
+ * The loops work on two lanes at a time with GCC vector extensions, min and max on SSE2's minpd
+ * and maxpd. Loads and stores are unaligned, an array only has to be aligned for a double.
+ * Reductions keep partial results per lane and combine them at the end, so a sum may round
+ * differently in the last bits than a left to right sum would. min and max give NaN if any
+ * element is NaN. Empty input sums to 0, min and max need at least one element.
+ */
+double sumDoubles(const double *values, int count);
+double minDoubles(const double *values, int count);
+double maxDoubles(const double *values, int count);
+double dotDoubles(const double *a, const double *b, int count);
+void addDoubles(double *result, const double *a, const double *b, int count);
+void mulDoubles(double *result, const double *a, const double *b, int count);
+void scaleDoubles(double *result, const double *values, double factor, int count);
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef slorp_batch_h
+#define slorp_batch_h
+
+#include <stdio.h>
+
+#include "vm.h"
+
+/**
+ * @brief Batch mode, runs many scripts in one process
+ * Every script is compiled once by the calling VM, then the chunks are run on a pool of
+ * worker threads. Each run gets a fresh VM (stack, heap, globals) on its worker, the chunk
+ * bytecode and constants are shared read-only. Output of every script is buffered and
+ * written to the output of `vm` in script order, a per-script report goes to `report`.
+ *
+ * @param vm compiles the scripts and owns their constants, must outlive the batch
+ * @param paths script files
+ * @param count number of paths
+ * @param jobs worker threads, 0 picks the number of online CPUs
+ * @param report where the per-script results and timings are written
+ * @return process exit code, 0 when every script ran, 65 / 70 / 74 for the first failure
+ */
+int runBatch(VM *vm, const char *const *paths, int count, int jobs, FILE *report);
+
+#endif
@@ -34,8 +34,105 @@ typedef enum
     OP_SET_LOCAL,
     OP_PRINT, // statemtn -> print expression
     OP_POP,
+    // Unchecked arithmetic, emitted only where the compiler proved both operands are doubles
+    OP_NEGATE_NUMBER,
+    OP_ADD_NUMBER,
+    OP_SUBTRACT_NUMBER,
+    OP_MULTIPLY_NUMBER,
+    OP_DIVIDE_NUMBER,
+    OP_GREATER_NUMBER,
+    OP_LESS_NUMBER,
+    // Local slots past UINT8_MAX, two operand bytes high byte first
+    OP_GET_LOCAL_LONG,
+    OP_SET_LOCAL_LONG,
+    // Arrays of doubles, see array.h
+    OP_ARRAY,        // [a, b, c], the operand is the element count, pops that many
+    OP_GET_INDEX,    // array[index], or map[key]
+    OP_SET_INDEX,    // array[index] = value or map[key] = value, leaves the value
+    OP_ARRAY_UNARY,  // array.method(), the operand is an ArrayMethod, map.length() too
+    OP_ARRAY_BINARY, // array.method(argument)
+    // Maps from strings to values, see ObjMap
+    OP_MAP,          // {k: v, ...}, the operand is the entry count, pops a key and a value per entry
+    OP_MAP_CONTAINS, // map.contains(key)
+    OP_MAP_DELETE,   // map.delete(key), whether the key was there
 } OpCode;
 
+#define OP_COUNT (OP_MAP_DELETE + 1)
+
+/**
+ * @brief One instruction of a chunk's execution form, decoded once before the chunk runs
+ * Operands are resolved ahead of time: constants and global names are copied into the record
+ * and local slots widened, so run() reads one fixed-size record per instruction instead of
+ * operand bytes and then the constant pool. The *_LOCAL_LONG forms decode to their short opcode.
+ */
+typedef struct
+{
+    uint8_t op;
+    int offset; // of the instruction in `code`, for source lines and the disassembly
+    union
+    {
+        Value constant;  // OP_CONSTANT
+        ObjString *name; // OP_DEFINE_GLOBAL, OP_GET_GLOBAL, OP_SET_GLOBAL
+        int slot;        // OP_GET_LOCAL, OP_SET_LOCAL
+        int count;       // OP_ARRAY, OP_MAP
+        int method;      // OP_ARRAY_UNARY, OP_ARRAY_BINARY
+    } as;
+} Instr;
+
+/**
+ * @brief Opcodes of the register backend, three-address forms of the stack opcodes
+ * `a` is the register written, `b` and `c` the registers read. Registers are the stack slots
+ * of the stack machine, so locals keep their slot numbers, followed by registers preloaded
+ * with the constants, nil, true and false before the run.
+ */
+typedef enum
+{
+    REG_MOVE,          // a = b
+    REG_NOT,           // a = !b
+    REG_NEGATE,        // a = -b
+    REG_NEGATE_NUMBER, // a = -b, b proven a double
+    REG_ADD,           // a = b + c
+    REG_SUBTRACT,
+    REG_MULTIPLY,
+    REG_DIVIDE,
+    REG_EQUAL,
+    REG_GREATER,
+    REG_LESS,
+    REG_ADD_NUMBER, // unchecked, b and c proven doubles
+    REG_SUBTRACT_NUMBER,
+    REG_MULTIPLY_NUMBER,
+    REG_DIVIDE_NUMBER,
+    REG_GREATER_NUMBER,
+    REG_LESS_NUMBER,
+    REG_ARRAY,         // a = [c registers from b on]
+    REG_GET_INDEX,     // a = b[c]
+    REG_SET_INDEX,     // a[b] = c
+    REG_ARRAY_UNARY,   // a = b.method()
+    REG_ARRAY_BINARY,  // a = b.method(c)
+    REG_MAP,           // a = {c keys and values from b on, alternating}
+    REG_MAP_CONTAINS,  // a = b.contains(c)
+    REG_MAP_DELETE,    // a = b.delete(c)
+    REG_DEFINE_GLOBAL, // name = b
+    REG_GET_GLOBAL,    // a = name
+    REG_SET_GLOBAL,    // name = b
+    REG_PRINT,         // print b
+    REG_RETURN,
+} RegOp;
+
+typedef struct
+{
+    uint8_t op;
+    uint8_t method; // REG_ARRAY_UNARY, REG_ARRAY_BINARY
+    int offset;     // of the stack instruction it was translated from
+    int a;
+    int b;
+    union
+    {
+        int c;
+        ObjString *name; // the global opcodes
+    } as;
+} RegInstr;
+
 /**
  * @brief Bytecode is a series of instructions.
  *
@@ -47,11 +144,48 @@ typedef struct
     uint8_t *code;
     int *lines;
     ValueArray constants;
+    bool verified;        // passed verifyChunk and was not written to since
+    int maxStackDepth;    // deepest the stack gets while running it, set by verifyChunk
+    int preparedCount;    // code before this offset is verified and has its records, see prepareChunk
+    Instr *instructions;  // execution form built by prepareChunk, NULL until then
+    int instructionCount;
+    int instructionCapacity;
+    RegInstr *registerCode; // register backend form, built by prepareChunk for VMs that use it
+    int registerCodeCount;
+    int registerCodeCapacity;
+    int registerCount;   // stack slots plus constant registers
+    int registerSlots;   // stack slot registers the register code was laid out for
+    int translatedCount; // code before this offset has its register code, see translateRegisters
 } Chunk;
 
 void initChunk(Chunk *chunk);
-void writeChunk(Chunk *chunk, uint8_t byte, int line);
-void freeChunk(Chunk *chunk);
-int addConstant(Chunk *chunk, Value value); // Convenience function to add constants into a chunk
+void writeChunk(VM *vm, Chunk *chunk, uint8_t byte, int line);
+void freeChunk(VM *vm, Chunk *chunk);
+int addConstant(VM *vm, Chunk *chunk, Value value); // Convenience function to add constants into a chunk
+
+/**
+ * @brief Makes a finished chunk ready to run: verifies it and builds its instruction records
+ * When `vm` runs the register backend the register code is translated as well. Steps already
+ * done are skipped, so a prepared chunk is only read from then on and may be run by several
+ * VMs (of the same backend) at once. Code written after preparing is verified, decoded and
+ * translated to register code on its own by the next prepare. The register code is translated
+ * again as a whole only when the new code makes the stack deeper, see regcode.h.
+ *
+ * @param errorOffset set to the offending bytecode offset when verification fails, may be NULL
+ * @return NULL once the chunk can run, otherwise what verifyChunk found wrong with it
+ */
+const char *prepareChunk(VM *vm, Chunk *chunk, int *errorOffset);
+
+/**
+ * @brief Opens a prepared chunk for more code by removing its final OP_RETURN
+ * What ran before keeps its records, so appending, preparing and running the new code with
+ * runChunkFrom costs only as much as the new code. The verifier guarantees the stack is empty
+ * at the final OP_RETURN, which is where the appended code starts.
+ * @return the offset the appended code starts at
+ */
+int reopenChunk(Chunk *chunk);
+
+// Drops the code from `count` on and the constants from `constantCount` on, both not prepared yet
+void rewindChunk(Chunk *chunk, int count, int constantCount);
 
 #endif
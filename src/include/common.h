@@ -3,9 +3,8 @@
 
 #include <stdbool.h>
 
-// #define DEBUG_TRACE_EXECUTION
-#define DEBUG_PRINT_CODE
 #define UINT8_COUNT (UINT8_MAX + 1)
+#define UINT16_COUNT (UINT16_MAX + 1)
 
 #define HANDLE_ERROR(expr, msg, arg)       \
     do                                     \
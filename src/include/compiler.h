@@ -2,25 +2,42 @@
 #define slorp_compiler_h
 
 #include <stdbool.h>
+#include "arena.h"
 #include "chunk.h"
+#include "common.h"
 #include "scanner.h"
+#include "tokens.h"
+#include "vm.h"
+
+typedef struct Compiler Compiler;
+
+#define CONSTANT_INDEX_SIZE (UINT8_COUNT * 2) // at most half full, a chunk holds UINT8_COUNT constants
 
 /**
- * @brief Take a users program and fill up the chunk with bytecode
- *
- * @param source text source code
- * @param chunk empty chunk to fill bytecode with
+ * @brief State of one compilation, everything the front end reads or writes lives here
  */
-bool compile(const char *source, Chunk *chunk);
-
-typedef struct
+struct Parser
 {
+    Scanner scanner;
+    TokenBuffer *tokens; // scanned ahead by lexParallel, NULL when the scanner runs along with the parser
     Token current;
     Token previous;
     bool hadError;
     bool panicMode;
-} Parser;
+    VM *vm;             // owns the strings and memory the compiled chunk refers to
+    Compiler *compiler; // innermost scope being compiled
+    Chunk *chunk;       // chunk we are compiling TO
+    Arena arena;        // scratch of this compile, released when it ends
+    int16_t *constantIndex; // hash of the chunk's constants to their index, CONSTANT_INDEX_SIZE slots, -1 when empty
+};
 
-extern Parser parser;
+/**
+ * @brief Take a users program and fill up the chunk with bytecode
+ *
+ * @param vm the VM whose heap and string table the chunk's constants live in
+ * @param source text source code
+ * @param chunk empty chunk to fill bytecode with
+ */
+bool compile(VM *vm, const char *source, Chunk *chunk);
 
 #endif
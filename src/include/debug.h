@@ -1,9 +1,35 @@
 #ifndef slorp_debug_h
 #define slorp_debug_h
 
+#include <stdbool.h>
+#include <stdio.h>
+
 #include "chunk.h"
 
-void dissassembleChunk(Chunk *chunk, const char *name);
-int dissassembleInstruction(Chunk *chunk, int offset);
+/**
+ * @brief Diagnostics a VM can be asked for at runtime, flags of VM.diagnostics
+ * Set with `--diagnostics` or the SLORP_DIAGNOSTICS environment variable, a comma separated list
+ * of the names below. Everything is written to the VM's error stream. With none set the compiler
+ * skips its disassembly and the VM runs its untraced dispatch loops, so they cost nothing.
+ */
+typedef enum
+{
+    DIAG_DISASSEMBLE = 1 << 0, // "disassemble", every compiled chunk
+    DIAG_TRACE = 1 << 1,       // "trace", every instruction before it runs
+    DIAG_STACK = 1 << 2,       // "stack", the stack (or the registers) before every instruction
+} Diagnostic;
+
+#define DIAGNOSTICS_ENV "SLORP_DIAGNOSTICS"
+
+// Turns a list like "disassemble,trace" into Diagnostic flags, false on an unknown name
+bool parseDiagnostics(const char *list, int *diagnostics);
+
+void dissassembleChunk(FILE *out, Chunk *chunk, const char *name);
+int dissassembleInstruction(FILE *out, Chunk *chunk, int offset);
+void dissassembleInstructions(FILE *out, Chunk *chunk, const char *name); // the prepared records, by their bytecode offset
+void dissassembleRegisterCode(FILE *out, Chunk *chunk, const char *name);
+void dissassembleRegisterInstruction(FILE *out, Chunk *chunk, RegInstr *instr);
+void dumpStack(FILE *out, Value *bottom, Value *top); // the values from bottom up to top
+void printDebugValue(FILE *out, Value value);         // printValue to a stdio stream, in order with its fprintf's
 
-#endif
\ No newline at end of file
+#endif
@@ -1,8 +1,10 @@
 #ifndef slorp_error_h
 #define slorp_error_h
 
+typedef struct Parser Parser;
+
 /// Some public helper functions for logging error!
-void errorAtCurrentToken(const char *message);
-void errorAtPreviousToken(const char *message);
+void errorAtCurrentToken(Parser *parser, const char *message);
+void errorAtPreviousToken(Parser *parser, const char *message);
 
 #endif
\ No newline at end of file
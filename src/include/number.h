@@ -0,0 +1,41 @@
+#ifndef slorp_number_h
+#define slorp_number_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Longest formatNumber result: sign, 17 digits, point, "e-324" and the terminator
+#define NUMBER_BUFFER_SIZE 32
+
+/**
+ * @brief Writes the shortest decimal that reads back as exactly `value` (Grisu2)
+ * Plain notation for decimal exponents -5 to 20, otherwise d.ddde+XX like printf's %g,
+ * nan and inf are spelled like printf spells them.
+ *
+ * @param buffer at least NUMBER_BUFFER_SIZE bytes, NUL terminated on return
+ * @return number of characters written, without the terminator
+ */
+int formatNumber(double value, char *buffer);
+
+/**
+ * @brief Parses a number literal, digits with an optional '.' and fraction
+ * Literals with at most 19 significant digits whose value is exactly representable take an
+ * exact integer fast path that never consults the locale, anything else falls back to strtod.
+ */
+double parseNumber(const char *start, int length);
+
+/**
+ * @brief Parses a number literal that is a whole number fitting an int64
+ * @return false when the literal has a '.' or is larger than INT64_MAX, `value` is then untouched
+ */
+bool parseInteger(const char *start, int length, int64_t *value);
+
+/**
+ * @brief Writes `value` in decimal, a '-' in front when negative
+ * @param buffer at least NUMBER_BUFFER_SIZE bytes, NUL terminated on return
+ * @return number of characters written, without the terminator
+ */
+int formatInteger(int64_t value, char *buffer);
+
+#endif
@@ -3,6 +3,7 @@
 
 #include"common.h"
 #include"value.h"
+#include"table.h"
 
 #include<stdint.h>
 
@@ -10,17 +11,25 @@
 #define IS_STRING(value) isObjType(value, OBJ_STRING)
 #define AS_STRING(value) ((ObjString*)AS_OBJ(value))
 #define AS_CSTRING(value) (((ObjString*)AS_OBJ(value))->chars)
+#define IS_ARRAY(value) isObjType(value, OBJ_ARRAY)
+#define AS_ARRAY(value) ((ObjArray*)AS_OBJ(value))
+#define IS_MAP(value) isObjType(value, OBJ_MAP)
+#define AS_MAP(value) ((ObjMap*)AS_OBJ(value))
 
 typedef enum {
 	OBJ_STRING,
+	OBJ_ARRAY,
+	OBJ_MAP,
 } ObjType;
 
+#define OBJ_TYPE_COUNT (OBJ_MAP + 1)
+
 struct Obj {
 	ObjType type;
 	struct Obj* next; // Intrusive list
 };
 
-void printObject(Value value);
+void printObject(Output* out, Value value);
 
 struct ObjString {
 	Obj obj;
@@ -28,8 +37,35 @@ struct ObjString {
 	char* chars;
 	uint32_t hash; // Avoiding having to rerun hash function on lookup
 };
-ObjString* copyString(const char* chars, int length);
-ObjString* takeString(char* chars, int length);
+ObjString* copyString(VM* vm, const char* chars, int length);
+ObjString* takeString(VM* vm, char* chars, int length);
+
+// Fixed length and packed, so the bulk operations in array.h run over the doubles directly
+typedef struct
+{
+	Obj obj;
+	int count;
+	double* values;
+} ObjArray;
+// `count` elements, left uninitialized for the caller to fill
+ObjArray* newArray(VM* vm, int count);
+
+#define MAP_MAX_LITERAL 255 // entries of a map literal, one operand byte
+
+// String keys to values of any type, in a Table like the globals. Deleted keys stay in the
+// table's count as tombstones, so the map counts its keys itself.
+typedef struct
+{
+	Obj obj;
+	int count;
+	Table table;
+} ObjMap;
+// Empty, with room for `capacity` keys before its table grows
+ObjMap* newMap(VM* vm, int capacity);
+// true when `key` is new to the map
+bool mapSet(VM* vm, ObjMap* map, ObjString* key, Value value);
+// false when the map has no `key`
+bool mapDelete(VM* vm, ObjMap* map, ObjString* key);
 
 static inline bool isObjType(Value value, ObjType type)
 {
@@ -0,0 +1,56 @@
+#ifndef slorp_output_h
+#define slorp_output_h
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define OUTPUT_DEFAULT_CAPACITY (64 * 1024)
+
+typedef enum
+{
+    OUTPUT_FLUSH_FULL, // only when the buffer fills up, on exit and before errors
+    OUTPUT_FLUSH_LINE, // additionally after every print statement
+} FlushPolicy;
+
+/**
+ * @brief Receives flushed output instead of a file descriptor, returns false on failure
+ */
+typedef bool (*OutputSink)(void *context, const char *bytes, size_t length);
+
+/**
+ * @brief Buffered program output of a VM, what print statements write to
+ * Bypasses stdio: bytes are collected in the buffer and handed to write(2) on `fd`,
+ * or to `sink` when an embedder wants them elsewhere. The buffer is allocated by the first write.
+ */
+typedef struct
+{
+    char *buffer;
+    size_t count;
+    size_t capacity;
+    FlushPolicy policy;
+    int fd;
+    OutputSink sink;
+    void *sinkContext;
+    bool failed; // a write failed, later output is dropped
+} Output;
+
+/**
+ * @param capacity buffer size in bytes, 0 picks OUTPUT_DEFAULT_CAPACITY
+ */
+void initOutput(Output *output, int fd, size_t capacity, FlushPolicy policy);
+void setOutputSink(Output *output, OutputSink sink, void *context);
+void freeOutput(Output *output); // flushes first
+
+void writeOutput(Output *output, const char *bytes, size_t length);
+void writeOutputChar(Output *output, char c);
+bool flushOutput(Output *output);
+
+// End of one print statement, flushes under OUTPUT_FLUSH_LINE
+static inline void endOutputLine(Output *output)
+{
+    writeOutputChar(output, '\n');
+    if (output->policy == OUTPUT_FLUSH_LINE)
+        flushOutput(output);
+}
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef slorp_probes_h
+#define slorp_probes_h
+
+/**
+ * @brief USDT static probes under the `slorp` provider, for perf/bpftrace/SystemTap
+ * With SLORP_USDT defined these expand to <sys/sdt.h> probes, a single nop per site until a
+ * tracer attaches. Without it they expand to nothing.
+ *
+ *   compile__start(source, length)         compile__done(ok, bytecodeBytes, constants)
+ *   interpret__start(source)               interpret__done(result)
+ *   object__alloc(object, type, size)      table__resize(table, oldCapacity, newCapacity)
+ *   string__intern(chars, length, hit)     runtime__error(message, line)
+ */
+
+#ifdef SLORP_USDT
+
+#include <sys/sdt.h>
+
+#define PROBE_COMPILE_START(source, length) DTRACE_PROBE2(slorp, compile__start, source, length)
+#define PROBE_COMPILE_DONE(ok, bytes, constants) DTRACE_PROBE3(slorp, compile__done, ok, bytes, constants)
+#define PROBE_INTERPRET_START(source) DTRACE_PROBE1(slorp, interpret__start, source)
+#define PROBE_INTERPRET_DONE(result) DTRACE_PROBE1(slorp, interpret__done, result)
+#define PROBE_OBJECT_ALLOC(object, type, size) DTRACE_PROBE3(slorp, object__alloc, object, type, size)
+#define PROBE_TABLE_RESIZE(table, oldCapacity, newCapacity) \
+    DTRACE_PROBE3(slorp, table__resize, table, oldCapacity, newCapacity)
+#define PROBE_STRING_INTERN(chars, length, hit) DTRACE_PROBE3(slorp, string__intern, chars, length, hit)
+#define PROBE_RUNTIME_ERROR(message, line) DTRACE_PROBE2(slorp, runtime__error, message, line)
+
+#else
+
+#define PROBE_COMPILE_START(source, length) ((void)0)
+#define PROBE_COMPILE_DONE(ok, bytes, constants) ((void)0)
+#define PROBE_INTERPRET_START(source) ((void)0)
+#define PROBE_INTERPRET_DONE(result) ((void)0)
+#define PROBE_OBJECT_ALLOC(object, type, size) ((void)0)
+#define PROBE_TABLE_RESIZE(table, oldCapacity, newCapacity) ((void)0)
+#define PROBE_STRING_INTERN(chars, length, hit) ((void)0)
+#define PROBE_RUNTIME_ERROR(message, line) ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef slorp_profiler_h
+#define slorp_profiler_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "object.h"
+
+typedef struct VM VM;
+
+/**
+ * @brief Heap profiler, attributes every allocation of a VM to a Slorp source line
+ * While running the line comes from vm->ip, while compiling from the parsers current token.
+ * Allocations made by allocateObject are tagged with their ObjType, everything else
+ * (strings characters, tables, chunks) is reported as raw memory.
+ */
+
+#define PROFILE_RAW (-1)
+
+typedef struct
+{
+    int line;
+    int kind; // ObjType or PROFILE_RAW
+    bool compiling;
+    size_t count;
+    size_t bytes;
+} AllocationSite;
+
+typedef struct
+{
+    bool enabled;
+    int nextKind; // tag for the next reallocate, set by allocateObject
+    AllocationSite *sites;
+    int count;
+    int capacity;
+    size_t totalCount;
+    size_t totalBytes;
+} HeapProfiler;
+
+void initHeapProfiler(HeapProfiler *profiler);
+void enableHeapProfiler(HeapProfiler *profiler);
+void freeHeapProfiler(HeapProfiler *profiler);
+
+// Called by reallocate() for every allocation or growth when the profiler is enabled
+void profileAllocation(VM *vm, size_t bytes);
+
+static inline void profileNextAllocationAs(HeapProfiler *profiler, ObjType type)
+{
+    if (profiler->enabled)
+        profiler->nextKind = (int)type;
+}
+
+// Top allocation sites by bytes and by count. Also triggered by SIGUSR1 where available.
+void printHeapProfile(HeapProfiler *profiler, FILE *out);
+
+#endif
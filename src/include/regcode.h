@@ -0,0 +1,25 @@
+#ifndef slorp_regcode_h
+#define slorp_regcode_h
+
+#include "chunk.h"
+
+/**
+ * @brief Translates a prepared chunk's stack code into register code for the register backend
+ *
+ * The verifier knows the stack depth at every instruction, so each stack slot becomes a
+ * register and the translation is a single pass. Operands are forwarded instead of copied:
+ * a constant or local read only records which register holds the value, and the instruction
+ * consuming it reads that register directly. A store to a local retargets the instruction that
+ * computed the value, so `a = a + b;` becomes a single REG_ADD. Values that are still pending
+ * on a local are copied out before the local is overwritten.
+ *
+ * Translation resumes at `translatedCount`, where the stack is empty, so a growing session only
+ * translates the code it appended. Constant registers sit above nil, true and false, which sit
+ * above the stack slots, so new constants never move a register. Only a deeper stack does, and
+ * then the whole chunk is translated again.
+ *
+ * Sets `registerCode`, `registerCodeCount` and `registerCount` of the chunk, allocated in `vm`.
+ */
+void translateRegisters(VM *vm, Chunk *chunk);
+
+#endif
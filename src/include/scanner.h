@@ -8,8 +8,11 @@ typedef enum
     TOKEN_RIGHT_PAREN,
     TOKEN_LEFT_BRACE,
     TOKEN_RIGHT_BRACE,
+    TOKEN_LEFT_BRACKET,
+    TOKEN_RIGHT_BRACKET,
     TOKEN_COMMA,
     TOKEN_DOT,
+    TOKEN_COLON,
     TOKEN_MINUS,
     TOKEN_PLUS,
     TOKEN_SEMICOLON,
@@ -58,7 +61,14 @@ typedef struct
     int line;
 } Token;
 
-void initScanner(const char *source);
-Token scanToken();
+typedef struct
+{
+    const char *start;
+    const char *current;
+    int line;
+} Scanner;
+
+void initScanner(Scanner *scanner, const char *source);
+Token scanToken(Scanner *scanner);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,41 @@
+#ifndef slorp_serialize_h
+#define slorp_serialize_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chunk.h"
+
+/**
+ * @brief Precompiled bytecode, a compiled chunk written to bytes and read back
+ *
+ * Layout, all integers little endian:
+ *   "SLRP" u8 version
+ *   u32 constant count, then per constant a u8 ValueType and its payload
+ *       (bool u8, number 8 byte IEEE double, int 8 byte two's complement,
+ *        string u32 length + bytes, nil nothing)
+ *   u32 code length, the code bytes, then one i32 source line per code byte
+ */
+
+#define BYTECODE_MAGIC "SLRP"
+#define BYTECODE_MAGIC_LENGTH 4
+#define BYTECODE_VERSION 1
+
+// Does the buffer start like serialized bytecode, rather than source
+bool isBytecode(const uint8_t *bytes, size_t length);
+
+/**
+ * @brief Writes `chunk` into a new malloc'ed buffer
+ * @return the buffer, the caller frees it, its size goes to `length`
+ */
+uint8_t *serializeChunk(Chunk *chunk, size_t *length);
+
+/**
+ * @brief Rebuilds a chunk from serialized bytes, its strings are allocated in `vm`
+ * The bytes may come from outside the process, so every count is bounds checked and the
+ * code has to pass verifyChunk, the chunk comes back prepared. On failure the chunk is left empty.
+ */
+bool deserializeChunk(VM *vm, const uint8_t *bytes, size_t length, Chunk *chunk);
+
+#endif
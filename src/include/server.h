@@ -0,0 +1,55 @@
+#ifndef slorp_server_h
+#define slorp_server_h
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Warm interpreter daemon, `slorp --serve <socket>` and its client `slorp_client`
+ *
+ * Client and server exchange frames over a Unix domain stream socket: one byte frame type,
+ * a u32 little endian payload length, then the payload. A client sends one request frame
+ * per script and reads frames back until FRAME_DONE, any number of requests per connection.
+ */
+
+#define SERVER_DEFAULT_SOCKET "/tmp/slorp.sock"
+#define FRAME_MAX_PAYLOAD (64 * 1024 * 1024)
+
+typedef enum
+{
+    FRAME_SOURCE = 'S',   // client -> server, Slorp source text
+    FRAME_BYTECODE = 'B', // client -> server, a chunk written by serializeChunk
+    FRAME_OUTPUT = 'O',   // server -> client, what the script printed
+    FRAME_ERROR = 'E',    // server -> client, compile or runtime error text
+    FRAME_DONE = 'D',     // server -> client, the request finished, payload is a DoneFrame
+} FrameType;
+
+/**
+ * @brief Payload of FRAME_DONE, sent as four u32 little endian values
+ */
+typedef struct
+{
+    uint32_t result;    // InterpretResult
+    uint32_t cached;    // 1 when the source was already compiled
+    uint32_t compileUs; // compiling or loading the bytecode
+    uint32_t runUs;
+} DoneFrame;
+
+bool writeFrame(int fd, uint8_t type, const void *payload, uint32_t length);
+
+/**
+ * @brief Reads one frame, the payload is malloc'ed and owned by the caller
+ * @return false on end of stream, an IO error or a payload above FRAME_MAX_PAYLOAD
+ */
+bool readFrame(int fd, uint8_t *type, uint8_t **payload, uint32_t *length);
+
+void encodeDone(const DoneFrame *done, uint8_t bytes[16]);
+bool decodeDone(const uint8_t *bytes, uint32_t length, DoneFrame *done);
+
+/**
+ * @brief Listens on `socketPath` and serves requests until SIGINT or SIGTERM
+ * @return process exit code
+ */
+int runServer(const char *socketPath);
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef slorp_session_h
+#define slorp_session_h
+
+#include "chunk.h"
+#include "vm.h"
+
+/**
+ * @brief Source fed in pieces, compiled and run as if it were one growing script
+ * Every piece is compiled onto the end of the same chunk, so constants and the names of globals
+ * are shared with earlier pieces and only the new code is verified, decoded and run. Globals
+ * live in the VM and so carry over as well. What the REPL and embedders feeding code use.
+ */
+typedef struct
+{
+    VM *vm;
+    Chunk chunk; // everything run so far, ending in OP_RETURN
+} Session;
+
+void initSession(Session *session, VM *vm);
+void freeSession(Session *session);
+
+/**
+ * @brief Compiles `source` onto the session's chunk and runs just that code
+ * A piece that fails to compile leaves the session as it was before it. When the chunk's constants
+ * might not have room for the piece's, it goes on a new chunk, globals carry over all the same.
+ */
+InterpretResult feedSession(Session *session, const char *source);
+
+#endif
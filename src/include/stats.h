@@ -0,0 +1,77 @@
+#ifndef slorp_stats_h
+#define slorp_stats_h
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "common.h"
+#include "object.h"
+
+/**
+ * @brief Runtime counters of one VM, dumped by `--stats`
+ * Built when SLORP_STATS is defined (CMake option of the same name),
+ * otherwise every STAT_* macro expands to nothing.
+ */
+typedef struct
+{
+    // reallocate()
+    size_t allocations;
+    size_t reallocations;
+    size_t frees;
+    size_t bytesAllocated; // total growth, bytes handed out over the run
+    size_t bytesFreed;
+    size_t bytesLive;
+    size_t bytesPeak;
+
+    // allocateObject()
+    size_t objects[OBJ_TYPE_COUNT];
+    size_t objectBytes[OBJ_TYPE_COUNT];
+
+    // copyString() & takeString()
+    size_t internHits;
+    size_t internMisses;
+
+    // Tables
+    size_t tableLookups;
+    size_t tableProbes;
+    size_t tableResizes;
+    size_t tableResizeEntries; // live entries moved by adjustCapacity
+
+    // compile()
+    size_t chunksCompiled;
+    size_t chunkBytes;
+    size_t chunkBytesMax;
+    size_t chunkConstants;
+    size_t chunkConstantsMax;
+
+    // VM
+    size_t peakStackDepth;
+    size_t instructionsRun; // dispatched by either backend
+    size_t columnRowsBlocked; // runColumns(), rows run a block at a time
+    size_t columnRowsSingle; // and rows it ran one by one
+} Stats;
+
+#ifdef SLORP_STATS
+
+#define STAT_ADD(vm, field, amount) ((vm)->stats.field += (amount))
+#define STAT_INC(vm, field) STAT_ADD(vm, field, 1)
+#define STAT_MAX(vm, field, value)               \
+    do                                           \
+    {                                            \
+        if ((size_t)(value) > (vm)->stats.field) \
+            (vm)->stats.field = (value);         \
+    } while (false)
+
+#else
+
+// The arguments are referenced but not evaluated, so locals that only feed a counter stay used
+#define STAT_ADD(vm, field, amount) ((void)(vm), (void)sizeof(amount))
+#define STAT_INC(vm, field) ((void)(vm))
+#define STAT_MAX(vm, field, value) ((void)(vm), (void)sizeof(value))
+
+#endif
+
+// Writes every counter to `out`, or a note that stats were compiled out
+void printStats(Stats *stats, FILE *out);
+
+#endif
@@ -15,12 +15,17 @@ typedef struct {
 	Entry* entries;
 } Table;
 
+// The VM owns the memory of its tables and counts their probes, so every operation takes it
 void initTable(Table* table);
-void freeTable(Table* table);
-void tableAddAll(Table* from, Table* to);
-bool tableSet(Table* table, ObjString* key, Value value);
-bool tableGet(Table* table, ObjString* key, Value* value);
-bool tableDelete(Table* table, ObjString* key);
-ObjString* tableFindKey(Table* table, const char* chars, int length, uint32_t hash);
+void freeTable(VM* vm, Table* table);
+void tableAddAll(VM* vm, Table* from, Table* to);
+bool tableSet(VM* vm, Table* table, ObjString* key, Value value);
+bool tableGet(VM* vm, Table* table, ObjString* key, Value* value);
+bool tableDelete(VM* vm, Table* table, ObjString* key);
+ObjString* tableFindKey(VM* vm, Table* table, const char* chars, int length, uint32_t hash);
+// Grows the table so `count` keys fit without another resize
+void tableReserve(VM* vm, Table* table, int count);
+// Iterates the keys in table order: start `index` at 0, false once every key was visited
+bool tableNext(Table* table, int* index, ObjString** key, Value* value);
 
 #endif
@@ -0,0 +1,55 @@
+#ifndef slorp_tokens_h
+#define slorp_tokens_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "scanner.h"
+
+#define PARALLEL_LEX_MIN_BYTES (1024 * 1024) // smaller sources are scanned while parsing
+
+/**
+ * @brief A Token without the pointer, the source position is an offset so a record is 16 bytes
+ * TOKEN_ERROR records keep the index of their message in `messages` in `offset` instead.
+ */
+typedef struct
+{
+    uint32_t offset;
+    uint32_t length;
+    int32_t line;
+    uint8_t type; // TokenType
+} PackedToken;
+
+/**
+ * @brief Every token of a source, scanned ahead of the parser on several threads
+ *
+ * The source is cut after newlines into one region per thread. A newline is a safe place to
+ * cut unless it is inside a multi-line string, which can't be known without scanning what came
+ * before, so every region is scanned as if it started outside a string. Regions are then
+ * checked in order: when the region before ended with a token running past the cut, the cut was
+ * inside a string and everything from there on is scanned again serially. Lines are counted per
+ * region and added up afterwards, so tokens get the line numbers a serial scan would give them.
+ */
+typedef struct
+{
+    const char *source;
+    PackedToken *tokens; // ends with TOKEN_EOF
+    size_t count;
+    size_t next; // the token nextBufferedToken returns
+    const char **messages;
+    int messageCount;
+} TokenBuffer;
+
+/**
+ * @brief Scans `source` into `buffer` on `jobs` threads, 0 picks the number of online CPUs
+ * @return false when the source is too small (PARALLEL_LEX_MIN_BYTES) or too large for 32 bit
+ * offsets, only one thread would run or a thread can't be started, the buffer is not set up then
+ */
+bool lexParallel(TokenBuffer *buffer, const char *source, int jobs);
+void freeTokenBuffer(TokenBuffer *buffer);
+
+// The next token, what scanToken() would have returned, TOKEN_EOF from the end on
+Token nextBufferedToken(TokenBuffer *buffer);
+
+#endif
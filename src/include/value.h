@@ -2,17 +2,22 @@
 #define slorp_value_h
 
 #include<stdbool.h>
+#include<stdint.h>
+#include<stdio.h>
+#include"output.h"
 
 typedef struct Obj Obj; 
 typedef struct ObjString ObjString; 
+typedef struct VM VM;
 
 // This is the VM's notion of a type, not the users
 typedef enum
 {
   VAL_BOOL,
   VAL_NIL,
-  VAL_NUMBER,
+  VAL_NUMBER, // a double, integer literals and arithmetic on them give VAL_INT
   VAL_OBJ,
+  VAL_INT, // last, so the tags written into bytecode files keep their numbers
 } ValueType;
 
 typedef struct
@@ -22,28 +27,36 @@ typedef struct
   {
     bool boolean;
     double number;
+    int64_t integer;
     Obj* obj;
   } as;
 } Value;
 
-// Generic operation of comparing two values aka == 
+// Generic operation of comparing two values aka == , an integer equals the double of the same value
 bool valuesEqual(Value a, Value b);
 
 #define IS_BOOL(value) ((value).type == VAL_BOOL)
 #define IS_NIL(value) ((value).type == VAL_NIL)
 #define IS_NUMBER(value) ((value).type == VAL_NUMBER)
 #define IS_OBJ(value) ((value).type == VAL_OBJ)
+#define IS_INT(value) ((value).type == VAL_INT)
+// A number of either kind, what the language calls a number
+#define IS_NUMERIC(value) (IS_NUMBER(value) || IS_INT(value))
 
 // Demoting slorp values to native C values
 #define AS_BOOL(value) ((value).as.boolean)
 #define AS_NUMBER(value) ((value).as.number)
 #define AS_OBJ(value) ((value).as.obj)
+#define AS_INT(value) ((value).as.integer)
+// Either kind of number as a double
+#define AS_DOUBLE(value) (IS_INT(value) ? (double)AS_INT(value) : AS_NUMBER(value))
 
 // Promoting native C values to slorp values
 #define BOOL_VAL(value) ((Value){VAL_BOOL, {.boolean = value}})
 #define NIL_VAL ((Value){VAL_NIL, {.number = 0}})
 #define NUMBER_VAL(value) ((Value){VAL_NUMBER, {.number = value}})
 #define OBJ_VAL(object) ((Value){VAL_OBJ, {.obj = (Obj*)object}})
+#define INT_VAL(value) ((Value){VAL_INT, {.integer = value}})
 
 /**
  *  Constnat pool, an array of values.
@@ -57,8 +70,8 @@ typedef struct
 } ValueArray;
 
 void initValueArray(ValueArray *array);
-void writeValueArray(ValueArray *array, Value value);
-void freeValueArray(ValueArray *array);
-void printValue(Value value); // Utility for printing a Slorp Value
+void writeValueArray(VM *vm, ValueArray *array, Value value);
+void freeValueArray(VM *vm, ValueArray *array);
+void printValue(Output *out, Value value); // Utility for printing a Slorp Value
 
 #endif
@@ -0,0 +1,26 @@
+#ifndef slorp_verifier_h
+#define slorp_verifier_h
+
+#include "chunk.h"
+
+/**
+ * @brief Static check of a finished chunk, run by the compiler and when loading bytecode
+ *
+ * Walks the code once, simulating the stack depth: every opcode must be known with its
+ * operands inside the chunk, constant indices inside the constant pool (names of globals must
+ * be strings), local slots below the current depth, no instruction may pop an empty stack and
+ * the code has to end in OP_RETURN with an empty stack. The unchecked *_NUMBER opcodes are only
+ * accepted where the same inference the compiler does proves their operands are doubles. A chunk
+ * that passes gets `verified` set and its `maxStackDepth` filled in, the VM then sizes the stack
+ * once up front and runs it without per-instruction stack checks.
+ *
+ * Code appended to a verified chunk (see reopenChunk) is verified on its own: it starts on the
+ * empty stack the code before it left.
+ *
+ * @param start offset to verify from, 0 or the end of code that already passed
+ * @param errorOffset set to the offending instruction when verification fails, may be NULL
+ * @return NULL if the chunk is valid, otherwise what is wrong with it
+ */
+const char *verifyChunk(Chunk *chunk, int start, int *errorOffset);
+
+#endif
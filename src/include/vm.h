@@ -4,19 +4,50 @@
 #include "chunk.h"
 #include "value.h"
 #include "table.h"
+#include "stats.h"
+#include "profiler.h"
+#include "output.h"
 
-#define STACK_MAX 256
+#define STACK_DEFAULT_SIZE 256          // slots allocated when a VM first runs
+#define STACK_DEFAULT_MAX (1024 * 1024) // slots the stack may grow to before overflowing
+#define STACK_GUARD 1                    // slot below stack[0], runCached() spills an empty stack's top there
+#define COLUMN_BLOCK 256                 // rows a columnar run moves through each instruction together
 
-typedef struct
+typedef struct Parser Parser;
+
+typedef enum
+{
+    BACKEND_STACK,    // run() over the chunk's instruction records
+    BACKEND_REGISTER, // runRegisters() over its register code, see regcode.h
+    BACKEND_CACHED,   // runCached(), the stack machine with ip, stack top and top value in locals
+} Backend;
+
+/**
+ * @brief All interpreter state, one per independent interpreter
+ * Nothing is shared between VMs, so separate VMs can run on separate threads.
+ */
+struct VM
 {
     Chunk *chunk;
-    uint8_t *ip; // instruction pointer
-    Value stack[STACK_MAX];
+    Instr *ip;       // instruction pointer, into the running chunk's instruction records
+    RegInstr *rip;   // instruction pointer of the register backend
+    Backend backend; // which interpreter runs this VM's chunks, the stack machine by default
+    int diagnostics; // Diagnostic flags (debug.h), none by default
+    int lexJobs;     // threads scanning sources of PARALLEL_LEX_MIN_BYTES and up, 0 (default) one per CPU, 1 serial
+    Value *stack;    // allocated by the first run, grows up to stackMax, the registers too, STACK_GUARD slots below it
     Value *stackTop;
+    Value *stackEnd; // one past the last allocated slot
+    int stackSize;   // initial slots, set before the first run
+    int stackMax;    // equal to stackSize for a fixed size stack
     Table strings; // Interim strings
     Table globals;
     Obj *objects;
-} VM;
+    Parser *parser; // set while compile() runs, for attributing allocations
+    Output out;     // where print writes, stdout unless the embedder redirects it
+    FILE *err;      // where compile and runtime errors are reported, stderr by default
+    Stats stats;
+    HeapProfiler heapProfiler;
+};
 
 typedef enum
 {
@@ -25,16 +56,57 @@ typedef enum
     INTERPRET_RUNTIME_ERROR
 } InterpretResult;
 
-extern VM vm;
+void initVM(VM *vm);
+void freeVM(VM *vm);
+InterpretResult interpret(VM *vm, const char *source);
+
+/**
+ * @brief Runs a chunk that was compiled by any VM, possibly a different one
+ * The chunk is only read, so one chunk may be run by several VMs at once as long as
+ * the VM that compiled it outlives them all. Chunks from compile() and deserializeChunk() are
+ * already prepared, any other chunk is prepared (and so written to) by its first run.
+ */
+InterpretResult runChunk(VM *vm, Chunk *chunk);
+
+/**
+ * @brief Runs the code of a chunk compiled by `vm` from `offset` on
+ * `offset` has to be where the stack is empty between statements, like the offset
+ * reopenChunk returns, so code appended to a chunk runs without running what came before.
+ */
+InterpretResult runChunkFrom(VM *vm, Chunk *chunk, int offset);
+
+/**
+ * @brief One input of a columnar run, a column of numbers bound to a global
+ */
+typedef struct
+{
+    const char *name;     // of the global
+    const double *values; // one per row
+} InputColumn;
+
+/**
+ * @brief Runs `chunk` once per row of `inputs`, the inputs' globals holding that row's values
+ * The result of a row is the value the global `output` has when the row's run ends, written to
+ * `results[row]`. Chunks whose rows can't see each other run COLUMN_BLOCK rows at a time, every
+ * instruction dispatched once for the whole block and arithmetic done in loops over the block's
+ * doubles. That is when the chunk doesn't print and reads only globals that are inputs or that it
+ * defined before. Any other chunk, and a block where some row fails, runs one row after the other
+ * on the VM's backend, which reports the failure. Afterwards the globals hold the last row's values.
+ *
+ * @param rows number of rows, the length of every input column and of `results`
+ * @param failedRow set to the row that failed, -1 when every row ran
+ * @return INTERPRET_OK when every row ran
+ */
+InterpretResult runColumns(VM *vm, Chunk *chunk, const InputColumn *inputs, int inputCount, int rows,
+                           const char *output, Value *results, int *failedRow);
 
-void initVM();
-void freeVM();
-InterpretResult interpret(const char *source);
+// Offset in `code` of the instruction being run, for source lines of errors and allocations
+int currentOffset(VM *vm);
 
 /**
  * @brief Stack manipulation functions
  */
-void push(Value value);
-Value pop();
+void push(VM *vm, Value value);
+Value pop(VM *vm);
 
 #endif
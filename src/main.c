@@ -4,9 +4,16 @@
 #include <unistd.h>
 
 #include "include/common.h"
+#include "include/debug.h"
 #include "include/vm.h"
 #include "include/table.h"
 #include "include/object.h"
+#include "include/stats.h"
+#include "include/profiler.h"
+#include "include/batch.h"
+#include "include/server.h"
+#include "include/session.h"
+#include "include/compiler.h"
 
 #define DUMMY_LINE 123
 
@@ -29,10 +36,12 @@
 
 /**
  * @brief Take input from user while input is valid (ctrl+c will break)
- * run each line through interpret
+ * each line is fed to one session, so it compiles and runs only what the line adds
  */
-static void repl()
+static void repl(VM *vm)
 {
+    Session session;
+    initSession(&session, vm);
     char line[1024];
     for (;;)
     {
@@ -43,8 +52,10 @@ static void repl()
             break;
         }
 
-        interpret(line);
+        feedSession(&session, line);
+        flushOutput(&vm->out); // before the next prompt, also when stdout is not a terminal
     }
+    freeSession(&session);
 }
 
 /**
@@ -73,47 +84,330 @@ static char *readFile(const char *path)
 /**
  * @brief Reads file from path into string then runs it through interpreter
  * @param path to file
+ * @return process exit code
  */
-static void runFile(const char *path)
+static int runFile(VM *vm, const char *path)
 {
     char *source = readFile(path);
     // char *source = "";
-    InterpretResult result = interpret(source);
+    InterpretResult result = interpret(vm, source);
     free(source);
 
     switch (result)
     {
     case INTERPRET_COMPILE_ERROR:
-        exit(65);
-        break;
+        return 65;
     case INTERPRET_RUNTIME_ERROR:
-        exit(70);
-        break;
+        return 70;
     default:
-        break;
+        return 0;
     }
 }
 
+/**
+ * @brief Appends the script paths listed in a manifest, one per line, to `paths`
+ * Blank lines and lines starting with '#' are skipped. The paths point into the
+ * returned buffer, which has to stay alive while they are used.
+ */
+static char *readManifest(const char *manifest, const char ***paths, int *count, int *capacity)
+{
+    char *buffer = readFile(manifest);
+    for (char *line = strtok(buffer, "\r\n"); line != NULL; line = strtok(NULL, "\r\n"))
+    {
+        while (*line == ' ' || *line == '\t')
+            line++;
+        if (*line == '\0' || *line == '#')
+            continue;
+
+        if (*count == *capacity)
+        {
+            *capacity = *capacity < 8 ? 8 : *capacity * 2;
+            *paths = realloc(*paths, sizeof(const char *) * *capacity);
+        }
+        (*paths)[(*count)++] = line;
+    }
+    return buffer;
+}
+
+/**
+ * @brief Splits the next comma separated field off `*line`, blanks around it trimmed
+ * @return the field, NULL once the line has none left
+ */
+static char *nextField(char **line)
+{
+    if (*line == NULL)
+        return NULL;
+    char *field = *line;
+    char *comma = strchr(field, ',');
+    *line = comma != NULL ? comma + 1 : NULL;
+    if (comma != NULL)
+        *comma = '\0';
+
+    while (*field == ' ' || *field == '\t')
+        field++;
+    char *end = field + strlen(field);
+    while (end > field && (end[-1] == ' ' || end[-1] == '\t'))
+        end--;
+    *end = '\0';
+    return field;
+}
+
+/**
+ * @brief Runs a script once per row of a CSV file and prints the result of every row
+ * The first line of the file names the columns, the globals they are bound to, every line after
+ * it holds one number per column. See runColumns.
+ * @return process exit code
+ */
+static int runColumnsFile(VM *vm, const char *path, const char *columnsPath, const char *output)
+{
+    char *table = readFile(columnsPath);
+    InputColumn *columns = NULL;
+    double **values = NULL;
+    int columnCount = 0;
+    int rows = 0;
+    int capacity = 0;
+    int exitCode = 0;
+    int lineNumber = 0;
+    for (char *line = strtok(table, "\r\n"); line != NULL && exitCode == 0; line = strtok(NULL, "\r\n"))
+    {
+        lineNumber++;
+        if (columns == NULL)
+        {
+            // The header, a column per name
+            int names = 1;
+            for (const char *c = line; *c != '\0'; c++)
+                names += *c == ',';
+            columns = malloc(sizeof(InputColumn) * names);
+            values = calloc(names, sizeof(double *));
+            for (char *field = nextField(&line); field != NULL; field = nextField(&line))
+                columns[columnCount++].name = field;
+            continue;
+        }
+
+        if (rows == capacity)
+        {
+            capacity = capacity < 64 ? 64 : capacity * 2;
+            for (int i = 0; i < columnCount; i++)
+                values[i] = realloc(values[i], sizeof(double) * capacity);
+        }
+        int column = 0;
+        for (char *field = nextField(&line); field != NULL; field = nextField(&line), column++)
+        {
+            char *end;
+            double number = column < columnCount ? strtod(field, &end) : 0;
+            if (column >= columnCount || *field == '\0' || *end != '\0')
+                break;
+            values[column][rows] = number;
+        }
+        if (column != columnCount || line != NULL)
+        {
+            fprintf(stderr, "Expected %d numbers on line %d of \"%s\".\n", columnCount, lineNumber, columnsPath);
+            exitCode = 65;
+        }
+        rows++;
+    }
+    for (int i = 0; i < columnCount; i++)
+        columns[i].values = values[i];
+
+    Chunk chunk;
+    initChunk(&chunk);
+    char *source = exitCode == 0 ? readFile(path) : NULL;
+    if (source != NULL && !compile(vm, source, &chunk))
+        exitCode = 65;
+    if (exitCode == 0)
+    {
+        Value *results = malloc(sizeof(Value) * (rows > 0 ? rows : 1));
+        int failedRow;
+        InterpretResult result = runColumns(vm, &chunk, columns, columnCount, rows, output, results, &failedRow);
+        // The rows before a failed one have their results
+        int done = result == INTERPRET_OK ? rows : failedRow;
+        for (int row = 0; row < done; row++)
+        {
+            printValue(&vm->out, results[row]);
+            endOutputLine(&vm->out);
+        }
+        if (result != INTERPRET_OK)
+        {
+            flushOutput(&vm->out);
+            fprintf(stderr, "[row %d] in \"%s\"\n", failedRow + 1, columnsPath);
+            exitCode = 70;
+        }
+        free(results);
+    }
+
+    freeChunk(vm, &chunk);
+    free(source);
+    for (int i = 0; i < columnCount; i++)
+        free(values[i]);
+    free(values);
+    free(columns);
+    free(table);
+    return exitCode;
+}
+
+static void usage()
+{
+    fprintf(stderr,
+            "Usage: slorp [--stats] [--heap-profile] [--output-buffer bytes] [--flush line|full]\n"
+            "             [--stack-size slots] [--stack-max slots] [--backend stack|register|cached]\n"
+            "             [--diagnostics disassemble,trace,stack] [--lex-jobs N] [path]\n"
+            "       slorp --columns file.csv --result name [--backend stack|register|cached] path\n"
+            "       slorp --batch [--jobs N] [--manifest file] [--backend stack|register|cached] [path...]\n"
+            "       slorp --serve <socket>\n");
+    exit(64);
+}
+
 int main(int argc, const char *argv[])
 {
-    initVM();
-
-    runFile("test.slorp");
-
-    // if (argc == 1)
-    // {
-    //     repl();
-    // }
-    // else if (argc == 2)
-    // {
-    //     runFile(argv[1]);
-    // }
-    // else
-    // {
-    //     fprintf(stderr, "Usage: clox [path]\n");
-    // }
-
-    freeVM();
-
-    return 0;
+    const char *path = NULL;
+    bool showStats = false;
+    bool heapProfile = false;
+    bool batch = false;
+    int jobs = 0;
+    const char **paths = NULL; // batch scripts
+    int pathCount = 0;
+    int pathCapacity = 0;
+    char *manifest = NULL;
+    const char *socketPath = NULL;
+    const char *columnsPath = NULL; // CSV of input columns
+    const char *resultName = NULL;  // global holding a row's result
+    long outputBuffer = 0;
+    int stackSize = STACK_DEFAULT_SIZE;
+    int stackMax = STACK_DEFAULT_MAX;
+    Backend backend = BACKEND_STACK;
+    int diagnostics = 0;
+    int lexJobs = 0;
+    const char *diagnosticsList = getenv(DIAGNOSTICS_ENV);
+    if (diagnosticsList != NULL && !parseDiagnostics(diagnosticsList, &diagnostics))
+    {
+        fprintf(stderr, "Unknown diagnostic in %s=\"%s\".\n", DIAGNOSTICS_ENV, diagnosticsList);
+        return 64;
+    }
+    // Interactive output appears line by line, piped output is written when the buffer fills
+    FlushPolicy flushPolicy = isatty(STDOUT_FILENO) ? OUTPUT_FLUSH_LINE : OUTPUT_FLUSH_FULL;
+    for (int i = 1; i < argc; i++)
+    {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--stats") == 0)
+            showStats = true;
+        else if (strcmp(argv[i], "--heap-profile") == 0)
+            heapProfile = true;
+        else if (strcmp(argv[i], "--batch") == 0)
+            batch = true;
+        else if (strcmp(argv[i], "--stack-size") == 0 && hasValue)
+            stackSize = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--stack-max") == 0 && hasValue)
+            stackMax = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--output-buffer") == 0 && hasValue)
+            outputBuffer = atol(argv[++i]);
+        else if (strcmp(argv[i], "--flush") == 0 && hasValue)
+        {
+            const char *policy = argv[++i];
+            if (strcmp(policy, "line") == 0)
+                flushPolicy = OUTPUT_FLUSH_LINE;
+            else if (strcmp(policy, "full") == 0)
+                flushPolicy = OUTPUT_FLUSH_FULL;
+            else
+                usage();
+        }
+        else if (strcmp(argv[i], "--backend") == 0 && hasValue)
+        {
+            const char *name = argv[++i];
+            if (strcmp(name, "stack") == 0)
+                backend = BACKEND_STACK;
+            else if (strcmp(name, "register") == 0)
+                backend = BACKEND_REGISTER;
+            else if (strcmp(name, "cached") == 0)
+                backend = BACKEND_CACHED;
+            else
+                usage();
+        }
+        else if (strcmp(argv[i], "--diagnostics") == 0 && hasValue)
+        {
+            if (!parseDiagnostics(argv[++i], &diagnostics))
+                usage();
+        }
+        else if (strcmp(argv[i], "--lex-jobs") == 0 && hasValue)
+            lexJobs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--columns") == 0 && hasValue)
+            columnsPath = argv[++i];
+        else if (strcmp(argv[i], "--result") == 0 && hasValue)
+            resultName = argv[++i];
+        else if (strcmp(argv[i], "--serve") == 0 && hasValue)
+            socketPath = argv[++i];
+        else if (strcmp(argv[i], "--jobs") == 0 && hasValue)
+            jobs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--manifest") == 0 && hasValue && manifest == NULL)
+            manifest = readManifest(argv[++i], &paths, &pathCount, &pathCapacity);
+        else if (argv[i][0] == '-')
+            usage();
+        else if (batch)
+        {
+            if (pathCount == pathCapacity)
+            {
+                pathCapacity = pathCapacity < 8 ? 8 : pathCapacity * 2;
+                paths = realloc(paths, sizeof(const char *) * pathCapacity);
+            }
+            paths[pathCount++] = argv[i];
+        }
+        else if (path != NULL)
+            usage();
+        else
+            path = argv[i];
+    }
+    if ((jobs != 0 || manifest != NULL) && !batch)
+        usage();
+    if ((columnsPath == NULL) != (resultName == NULL) || (columnsPath != NULL && (batch || path == NULL)))
+        usage();
+    if (stackSize < 1 || stackMax < 1 || lexJobs < 0)
+        usage();
+    if (stackSize > stackMax)
+        stackSize = stackMax;
+    if (socketPath != NULL)
+    {
+        if (batch || path != NULL)
+            usage();
+        return runServer(socketPath);
+    }
+
+    VM vm;
+    initVM(&vm);
+    initOutput(&vm.out, STDOUT_FILENO, outputBuffer > 0 ? (size_t)outputBuffer : 0, flushPolicy);
+    vm.stackSize = stackSize;
+    vm.stackMax = stackMax;
+    vm.backend = backend;
+    vm.diagnostics = diagnostics;
+    vm.lexJobs = lexJobs;
+    if (heapProfile)
+        enableHeapProfiler(&vm.heapProfiler);
+
+    int exitCode = 0;
+    if (columnsPath != NULL)
+    {
+        exitCode = runColumnsFile(&vm, path, columnsPath, resultName);
+    }
+    else if (batch)
+    {
+        exitCode = pathCount > 0 ? runBatch(&vm, paths, pathCount, jobs, stderr) : 0;
+    }
+    else if (path == NULL)
+    {
+        repl(&vm);
+    }
+    else
+    {
+        exitCode = runFile(&vm, path);
+    }
+    flushOutput(&vm.out);
+
+    if (showStats)
+        printStats(&vm.stats, stderr);
+    if (heapProfile)
+        printHeapProfile(&vm.heapProfiler, stderr);
+
+    freeVM(&vm);
+    free(paths);
+    free(manifest);
+
+    return exitCode;
 }
@@ -1,12 +1,33 @@
-#include <stdatomic.h>
 #include <stdlib.h>
 
 #include "include/vm.h"
 #include "include/object.h"
 #include "include/memory.h"
+#include "include/stats.h"
+#include "include/profiler.h"
+#include "include/table.h"
 
-void *reallocate(void *pointer, size_t oldSize, size_t newSize)
+void *reallocate(VM *vm, void *pointer, size_t oldSize, size_t newSize)
 {
+#ifdef SLORP_STATS
+    if (newSize == 0)
+        STAT_INC(vm, frees);
+    else if (oldSize == 0)
+        STAT_INC(vm, allocations);
+    else
+        STAT_INC(vm, reallocations);
+
+    if (newSize > oldSize)
+        STAT_ADD(vm, bytesAllocated, newSize - oldSize);
+    else
+        STAT_ADD(vm, bytesFreed, oldSize - newSize);
+    vm->stats.bytesLive = vm->stats.bytesLive + newSize - oldSize;
+    STAT_MAX(vm, bytesPeak, vm->stats.bytesLive);
+#endif
+
+    if (vm->heapProfiler.enabled && newSize > oldSize)
+        profileAllocation(vm, newSize - oldSize);
+
     if (newSize == 0)
     {
         free(pointer);
@@ -19,26 +40,55 @@ void *reallocate(void *pointer, size_t oldSize, size_t newSize)
     return result;
 }
 
-static void freeObject(Obj *object)
+static void freeObject(VM *vm, Obj *object)
 {
     switch (object->type)
     {
     case OBJ_STRING:
     {
-        ObjString *string = (ObjString *)object;             // Convert to slorp string
-        FREE_ARRAY(char, string->chars, string->length + 1); // +1 because of \0
-        FREE(ObjString, object);
+        ObjString *string = (ObjString *)object;                 // Convert to slorp string
+        FREE_ARRAY(vm, char, string->chars, string->length + 1); // +1 because of \0
+        FREE(vm, ObjString, object);
+        break;
+    }
+    case OBJ_ARRAY:
+    {
+        ObjArray *array = (ObjArray *)object;
+        if (array->values != NULL)
+            FREE_ARRAY(vm, double, array->values, array->count);
+        FREE(vm, ObjArray, object);
+        break;
+    }
+    case OBJ_MAP:
+    {
+        ObjMap *map = (ObjMap *)object;
+        freeTable(vm, &map->table);
+        FREE(vm, ObjMap, object);
+        break;
     }
     }
 }
 
-void freeObjects()
+void freeObjects(VM *vm)
 {
-    Obj *object = vm.objects;
+    Obj *object = vm->objects;
     while (object != NULL)
     {
         Obj *next = object->next;
-        freeObject(object); // free memory
-        object = next;      // advance
+        freeObject(vm, object); // free memory
+        object = next;          // advance
+    }
+    vm->objects = NULL;
+}
+
+void freeObjectsSince(VM *vm, Obj *mark)
+{
+    while (vm->objects != mark)
+    {
+        Obj *object = vm->objects;
+        vm->objects = object->next;
+        if (object->type == OBJ_STRING)
+            tableDelete(vm, &vm->strings, (ObjString *)object);
+        freeObject(vm, object);
     }
 }
@@ -0,0 +1,442 @@
+#include "include/number.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Grisu2 after Loitsch, "Printing Floating-Point Numbers Quickly and Accurately with Integers".
+ * The output always reads back as the same double and is the shortest such decimal for
+ * all but a tiny fraction of inputs, which get one or two digits more.
+ */
+
+// Floating point number f * 2^e with a 64 bit significand ("do it yourself floating point")
+typedef struct
+{
+    uint64_t f;
+    int e;
+} DiyFp;
+
+typedef struct
+{
+    uint64_t f;
+    int e;
+    int k; // f * 2^e approximates 10^k
+} CachedPower;
+
+#define CACHED_POWERS_MIN_EXPONENT (-300)
+#define CACHED_POWERS_STEP 8
+#define ALPHA (-60) // the scaled exponent range digit generation works in
+#define GAMMA (-32)
+
+static const CachedPower cachedPowers[] = {
+    {0xAB70FE17C79AC6CA, -1060,  -300},
+    {0xFF77B1FCBEBCDC4F, -1034,  -292},
+    {0xBE5691EF416BD60C, -1007,  -284},
+    {0x8DD01FAD907FFC3C,  -980,  -276},
+    {0xD3515C2831559A83,  -954,  -268},
+    {0x9D71AC8FADA6C9B5,  -927,  -260},
+    {0xEA9C227723EE8BCB,  -901,  -252},
+    {0xAECC49914078536D,  -874,  -244},
+    {0x823C12795DB6CE57,  -847,  -236},
+    {0xC21094364DFB5637,  -821,  -228},
+    {0x9096EA6F3848984F,  -794,  -220},
+    {0xD77485CB25823AC7,  -768,  -212},
+    {0xA086CFCD97BF97F4,  -741,  -204},
+    {0xEF340A98172AACE5,  -715,  -196},
+    {0xB23867FB2A35B28E,  -688,  -188},
+    {0x84C8D4DFD2C63F3B,  -661,  -180},
+    {0xC5DD44271AD3CDBA,  -635,  -172},
+    {0x936B9FCEBB25C996,  -608,  -164},
+    {0xDBAC6C247D62A584,  -582,  -156},
+    {0xA3AB66580D5FDAF6,  -555,  -148},
+    {0xF3E2F893DEC3F126,  -529,  -140},
+    {0xB5B5ADA8AAFF80B8,  -502,  -132},
+    {0x87625F056C7C4A8B,  -475,  -124},
+    {0xC9BCFF6034C13053,  -449,  -116},
+    {0x964E858C91BA2655,  -422,  -108},
+    {0xDFF9772470297EBD,  -396,  -100},
+    {0xA6DFBD9FB8E5B88F,  -369,   -92},
+    {0xF8A95FCF88747D94,  -343,   -84},
+    {0xB94470938FA89BCF,  -316,   -76},
+    {0x8A08F0F8BF0F156B,  -289,   -68},
+    {0xCDB02555653131B6,  -263,   -60},
+    {0x993FE2C6D07B7FAC,  -236,   -52},
+    {0xE45C10C42A2B3B06,  -210,   -44},
+    {0xAA242499697392D3,  -183,   -36},
+    {0xFD87B5F28300CA0E,  -157,   -28},
+    {0xBCE5086492111AEB,  -130,   -20},
+    {0x8CBCCC096F5088CC,  -103,   -12},
+    {0xD1B71758E219652C,   -77,    -4},
+    {0x9C40000000000000,   -50,     4},
+    {0xE8D4A51000000000,   -24,    12},
+    {0xAD78EBC5AC620000,     3,    20},
+    {0x813F3978F8940984,    30,    28},
+    {0xC097CE7BC90715B3,    56,    36},
+    {0x8F7E32CE7BEA5C70,    83,    44},
+    {0xD5D238A4ABE98068,   109,    52},
+    {0x9F4F2726179A2245,   136,    60},
+    {0xED63A231D4C4FB27,   162,    68},
+    {0xB0DE65388CC8ADA8,   189,    76},
+    {0x83C7088E1AAB65DB,   216,    84},
+    {0xC45D1DF942711D9A,   242,    92},
+    {0x924D692CA61BE758,   269,   100},
+    {0xDA01EE641A708DEA,   295,   108},
+    {0xA26DA3999AEF774A,   322,   116},
+    {0xF209787BB47D6B85,   348,   124},
+    {0xB454E4A179DD1877,   375,   132},
+    {0x865B86925B9BC5C2,   402,   140},
+    {0xC83553C5C8965D3D,   428,   148},
+    {0x952AB45CFA97A0B3,   455,   156},
+    {0xDE469FBD99A05FE3,   481,   164},
+    {0xA59BC234DB398C25,   508,   172},
+    {0xF6C69A72A3989F5C,   534,   180},
+    {0xB7DCBF5354E9BECE,   561,   188},
+    {0x88FCF317F22241E2,   588,   196},
+    {0xCC20CE9BD35C78A5,   614,   204},
+    {0x98165AF37B2153DF,   641,   212},
+    {0xE2A0B5DC971F303A,   667,   220},
+    {0xA8D9D1535CE3B396,   694,   228},
+    {0xFB9B7CD9A4A7443C,   720,   236},
+    {0xBB764C4CA7A44410,   747,   244},
+    {0x8BAB8EEFB6409C1A,   774,   252},
+    {0xD01FEF10A657842C,   800,   260},
+    {0x9B10A4E5E9913129,   827,   268},
+    {0xE7109BFBA19C0C9D,   853,   276},
+    {0xAC2820D9623BF429,   880,   284},
+    {0x80444B5E7AA7CF85,   907,   292},
+    {0xBF21E44003ACDD2D,   933,   300},
+    {0x8E679C2F5E44FF8F,   960,   308},
+    {0xD433179D9C8CB841,   986,   316},
+    {0x9E19DB92B4E31BA9,  1013,   324},
+};
+
+static DiyFp diyFp(uint64_t f, int e)
+{
+    return (DiyFp){f, e};
+}
+
+static DiyFp subtract(DiyFp x, DiyFp y)
+{
+    return diyFp(x.f - y.f, x.e);
+}
+
+// Upper half of the 128 bit product, rounded
+static DiyFp multiply(DiyFp x, DiyFp y)
+{
+    unsigned __int128 product = (unsigned __int128)x.f * y.f;
+    uint64_t high = (uint64_t)(product >> 64);
+    uint64_t low = (uint64_t)product;
+    return diyFp(high + (low >> 63), x.e + y.e + 64);
+}
+
+static DiyFp normalize(DiyFp x)
+{
+    while ((x.f >> 63) == 0)
+    {
+        x.f <<= 1;
+        x.e--;
+    }
+    return x;
+}
+
+static DiyFp normalizeTo(DiyFp x, int e)
+{
+    return diyFp(x.f << (x.e - e), e);
+}
+
+/**
+ * @brief Splits a positive finite double into its normalized value and the boundaries
+ * halfway to its neighbours, every decimal strictly between them reads back as `value`
+ */
+static void boundaries(double value, DiyFp *v, DiyFp *minus, DiyFp *plus)
+{
+    const int bias = 1023 + 52;
+    const uint64_t hiddenBit = (uint64_t)1 << 52;
+
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint64_t exponent = bits >> 52;
+    uint64_t fraction = bits & (hiddenBit - 1);
+
+    DiyFp w = exponent == 0 ? diyFp(fraction, 1 - bias) // subnormal
+                            : diyFp(fraction + hiddenBit, (int)exponent - bias);
+    // At a power of two the next smaller double is half as far away as the next larger one
+    bool lowerIsCloser = fraction == 0 && exponent > 1;
+
+    DiyFp upper = diyFp(2 * w.f + 1, w.e - 1);
+    DiyFp lower = lowerIsCloser ? diyFp(4 * w.f - 1, w.e - 2) : diyFp(2 * w.f - 1, w.e - 1);
+
+    *plus = normalize(upper);
+    *minus = normalizeTo(lower, plus->e);
+    *v = normalize(w);
+}
+
+// The cached power that scales a number with binary exponent `e` into [ALPHA, GAMMA]
+static CachedPower cachedPowerFor(int e)
+{
+    const int f = ALPHA - e - 1;
+    const int k = (f * 78913) / (1 << 18) + (f > 0); // ceil(f * log10(2))
+    const int index = (-CACHED_POWERS_MIN_EXPONENT + k + (CACHED_POWERS_STEP - 1)) / CACHED_POWERS_STEP;
+    return cachedPowers[index];
+}
+
+// Digit count of n and the power of ten of its leading digit
+static int largestPow10(uint32_t n, uint32_t *pow10)
+{
+    static const uint32_t powers[] = {1, 10, 100, 1000, 10000, 100000, 1000000,
+                                      10000000, 100000000, 1000000000};
+    int digits = 10;
+    while (digits > 1 && n < powers[digits - 1])
+        digits--;
+    *pow10 = powers[digits - 1];
+    return digits;
+}
+
+// Moves the last digit towards w while it stays inside the boundaries
+static void roundWeed(char *digits, int length, uint64_t distance, uint64_t delta, uint64_t rest, uint64_t tenK)
+{
+    while (rest < distance && delta - rest >= tenK &&
+           (rest + tenK < distance || distance - rest > rest + tenK - distance))
+    {
+        digits[length - 1]--;
+        rest += tenK;
+    }
+}
+
+/**
+ * @brief Generates the digits of the shortest decimal between minus and plus, closest to w
+ * All three are scaled so their exponent lies in [ALPHA, GAMMA].
+ */
+static int generateDigits(char *digits, int *decimalExponent, DiyFp minus, DiyFp w, DiyFp plus)
+{
+    uint64_t delta = subtract(plus, minus).f;
+    uint64_t distance = subtract(plus, w).f;
+
+    const int shift = -plus.e;
+    const uint64_t one = (uint64_t)1 << shift;
+    uint32_t integral = (uint32_t)(plus.f >> shift);
+    uint64_t fractional = plus.f & (one - 1);
+
+    int length = 0;
+    uint32_t pow10;
+    int n = largestPow10(integral, &pow10);
+    while (n > 0)
+    {
+        digits[length++] = (char)('0' + integral / pow10);
+        integral %= pow10;
+        n--;
+
+        uint64_t rest = ((uint64_t)integral << shift) + fractional;
+        if (rest <= delta)
+        {
+            *decimalExponent += n;
+            roundWeed(digits, length, distance, delta, rest, (uint64_t)pow10 << shift);
+            return length;
+        }
+        pow10 /= 10;
+    }
+
+    int m = 0;
+    for (;;)
+    {
+        fractional *= 10;
+        digits[length++] = (char)('0' + (fractional >> shift));
+        fractional &= one - 1;
+        m++;
+        delta *= 10;
+        distance *= 10;
+        if (fractional <= delta)
+            break;
+    }
+    *decimalExponent -= m;
+    roundWeed(digits, length, distance, delta, fractional, one);
+    return length;
+}
+
+// Shortest digits of a positive finite double, the value is digits * 10^decimalExponent
+static int grisu2(double value, char *digits, int *decimalExponent)
+{
+    DiyFp v, minus, plus;
+    boundaries(value, &v, &minus, &plus);
+
+    CachedPower cached = cachedPowerFor(plus.e);
+    DiyFp c = diyFp(cached.f, cached.e);
+    DiyFp w = multiply(v, c);
+    DiyFp wMinus = multiply(minus, c);
+    DiyFp wPlus = multiply(plus, c);
+
+    // The products are off by at most one unit, shrink the range so it stays safe
+    wMinus.f++;
+    wPlus.f--;
+
+    *decimalExponent = -cached.k;
+    return generateDigits(digits, decimalExponent, wMinus, w, wPlus);
+}
+
+static int writeExponent(char *out, int exponent)
+{
+    int length = 0;
+    out[length++] = 'e';
+    out[length++] = exponent < 0 ? '-' : '+';
+    if (exponent < 0)
+        exponent = -exponent;
+    if (exponent >= 100)
+        out[length++] = (char)('0' + exponent / 100);
+    out[length++] = (char)('0' + exponent / 10 % 10); // at least two digits, like printf
+    out[length++] = (char)('0' + exponent % 10);
+    return length;
+}
+
+int formatNumber(double value, char *buffer)
+{
+    char *out = buffer;
+    if (isnan(value))
+    {
+        memcpy(buffer, "nan", 4);
+        return 3;
+    }
+    if (signbit(value))
+    {
+        *out++ = '-';
+        value = -value;
+    }
+    if (isinf(value))
+    {
+        memcpy(out, "inf", 4);
+        return (int)(out - buffer) + 3;
+    }
+    if (value == 0.0)
+    {
+        memcpy(out, "0", 2);
+        return (int)(out - buffer) + 1;
+    }
+
+    char digits[18];
+    int exponent;
+    int length = grisu2(value, digits, &exponent);
+    int point = length + exponent; // value is 0.digits * 10^point
+
+    if (point - 1 < -5 || point - 1 > 20)
+    {
+        *out++ = digits[0];
+        if (length > 1)
+        {
+            *out++ = '.';
+            memcpy(out, digits + 1, length - 1);
+            out += length - 1;
+        }
+        out += writeExponent(out, point - 1);
+    }
+    else if (point <= 0)
+    {
+        *out++ = '0';
+        *out++ = '.';
+        memset(out, '0', -point);
+        out += -point;
+        memcpy(out, digits, length);
+        out += length;
+    }
+    else if (point >= length)
+    {
+        memcpy(out, digits, length);
+        out += length;
+        memset(out, '0', point - length);
+        out += point - length;
+    }
+    else
+    {
+        memcpy(out, digits, point);
+        out += point;
+        *out++ = '.';
+        memcpy(out, digits + point, length - point);
+        out += length - point;
+    }
+
+    *out = '\0';
+    return (int)(out - buffer);
+}
+
+double parseNumber(const char *start, int length)
+{
+    // Every power of ten up to 10^22 is exact in a double
+    static const double powersOfTen[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                         1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+    uint64_t mantissa = 0;
+    int significant = 0;
+    int fractionDigits = 0;
+    bool fraction = false;
+    for (int i = 0; i < length; i++)
+    {
+        char c = start[i];
+        if (c == '.')
+        {
+            fraction = true;
+            continue;
+        }
+        if (significant > 0 || c != '0')
+            significant++;
+        mantissa = mantissa * 10 + (uint64_t)(c - '0');
+        fractionDigits += fraction;
+    }
+
+    if (significant <= 19)
+    {
+        // Converting the integer is one correctly rounded step, so is the single division
+        // as long as both operands are exact
+        if (fractionDigits == 0)
+            return (double)mantissa;
+        if (mantissa <= ((uint64_t)1 << 53) && fractionDigits <= 22)
+            return (double)mantissa / powersOfTen[fractionDigits];
+    }
+
+    // Slow path, correctly rounded by the C library. The token is not NUL terminated.
+    char small[64];
+    char *copy = length < (int)sizeof(small) ? small : malloc(length + 1);
+    memcpy(copy, start, length);
+    copy[length] = '\0';
+    double value = strtod(copy, NULL);
+    if (copy != small)
+        free(copy);
+    return value;
+}
+
+bool parseInteger(const char *start, int length, int64_t *value)
+{
+    uint64_t result = 0;
+    for (int i = 0; i < length; i++)
+    {
+        char c = start[i];
+        if (c == '.')
+            return false;
+        if (result > (INT64_MAX - (uint64_t)(c - '0')) / 10)
+            return false;
+        result = result * 10 + (uint64_t)(c - '0');
+    }
+    *value = (int64_t)result;
+    return true;
+}
+
+int formatInteger(int64_t value, char *buffer)
+{
+    // Digits are produced backwards, the magnitude as unsigned so INT64_MIN negates too
+    char digits[20];
+    uint64_t magnitude = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+    int count = 0;
+    do
+    {
+        digits[count++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude > 0);
+
+    char *out = buffer;
+    if (value < 0)
+        *out++ = '-';
+    while (count > 0)
+        *out++ = digits[--count];
+    *out = '\0';
+    return (int)(out - buffer);
+}
@@ -8,29 +8,37 @@
 #include "include/vm.h"
 #include "include/object.h"
 #include "include/table.h"
+#include "include/stats.h"
+#include "include/profiler.h"
+#include "include/probes.h"
+#include "include/number.h"
 
-#define ALLOCATE_OBJ(type, objectType) \
-	(type*)allocateObject(sizeof(type), objectType)
+#define ALLOCATE_OBJ(vm, type, objectType) \
+	(type*)allocateObject(vm, sizeof(type), objectType)
 
-static Obj* allocateObject(size_t size, ObjType type)
+static Obj* allocateObject(VM* vm, size_t size, ObjType type)
 {
-	Obj* object = (Obj*)reallocate(NULL, 0, size);
+	profileNextAllocationAs(&vm->heapProfiler, type);
+	Obj* object = (Obj*)reallocate(vm, NULL, 0, size);
 	object->type = type;
+	STAT_INC(vm, objects[type]);
+	STAT_ADD(vm, objectBytes[type], size);
+	PROBE_OBJECT_ALLOC(object, type, size);
 
 	// Insert this new object as head in the vm's pointer to objects
-	object->next = vm.objects;
-	vm.objects = object;
+	object->next = vm->objects;
+	vm->objects = object;
 	
 	return object;
 }
 
-static ObjString* allocateString(char* chars, int length, uint32_t hash)
+static ObjString* allocateString(VM* vm, char* chars, int length, uint32_t hash)
 {
-	ObjString* string = ALLOCATE_OBJ(ObjString, OBJ_STRING);
+	ObjString* string = ALLOCATE_OBJ(vm, ObjString, OBJ_STRING);
 	string->length = length;
 	string->chars = chars;
 	string->hash = hash;
-	tableSet(&vm.strings, string, NIL_VAL);
+	tableSet(vm, &vm->strings, string, NIL_VAL);
 	return string;
 }
 
@@ -46,40 +54,141 @@ static uint32_t hashString(const char* key, int length)
 	return hash;
 }
 
-ObjString* copyString(const char* chars, int length)
+ObjString* copyString(VM* vm, const char* chars, int length)
 {
 	uint32_t hash = hashString(chars, length);
-	ObjString* interned = tableFindKey(&vm.strings, chars, length, hash);
+	ObjString* interned = tableFindKey(vm, &vm->strings, chars, length, hash);
 	if (interned != NULL)
 	{
 		// String already exists
+		STAT_INC(vm, internHits);
+		PROBE_STRING_INTERN(chars, length, 1);
 		return interned;
 	}
+	STAT_INC(vm, internMisses);
+	PROBE_STRING_INTERN(chars, length, 0);
 	// First copy the literal string onto a newly allocated heap blob
-	char* heapChars = ALLOCATE(char, length + 1);
+	char* heapChars = ALLOCATE(vm, char, length + 1);
 	memcpy(heapChars, chars, length);
 	heapChars[length] = '\0';
-	return allocateString(heapChars, length, hash);
+	return allocateString(vm, heapChars, length, hash);
 }
 
-void printObject(Value value)
+ObjArray* newArray(VM* vm, int count)
+{
+	double* values = count > 0 ? ALLOCATE(vm, double, count) : NULL;
+	ObjArray* array = ALLOCATE_OBJ(vm, ObjArray, OBJ_ARRAY);
+	array->count = count;
+	array->values = values;
+	return array;
+}
+
+ObjMap* newMap(VM* vm, int capacity)
+{
+	ObjMap* map = ALLOCATE_OBJ(vm, ObjMap, OBJ_MAP);
+	map->count = 0;
+	initTable(&map->table);
+	tableReserve(vm, &map->table, capacity);
+	return map;
+}
+
+bool mapSet(VM* vm, ObjMap* map, ObjString* key, Value value)
+{
+	bool isNewKey = tableSet(vm, &map->table, key, value);
+	if (isNewKey)
+		map->count++;
+	return isNewKey;
+}
+
+bool mapDelete(VM* vm, ObjMap* map, ObjString* key)
+{
+	bool deleted = tableDelete(vm, &map->table, key);
+	if (deleted)
+		map->count--;
+	return deleted;
+}
+
+static void printArray(Output* out, ObjArray* array)
+{
+	writeOutput(out, "[", 1);
+	for (int i = 0; i < array->count; i++)
+	{
+		char number[NUMBER_BUFFER_SIZE];
+		int length = formatNumber(array->values[i], number);
+		if (i > 0)
+			writeOutput(out, ", ", 2);
+		writeOutput(out, number, length);
+	}
+	writeOutput(out, "]", 1);
+}
+
+// The maps being printed, innermost first, so a map that contains itself prints as {...} there
+typedef struct MapParent
+{
+	ObjMap* map;
+	const struct MapParent* next;
+} MapParent;
+
+// {key: value, ...} in the order of the map's table
+static void printMap(Output* out, ObjMap* map, const MapParent* parents)
+{
+	for (const MapParent* parent = parents; parent != NULL; parent = parent->next)
+	{
+		if (parent->map == map)
+		{
+			writeOutput(out, "{...}", 5);
+			return;
+		}
+	}
+
+	MapParent self = {map, parents};
+	writeOutput(out, "{", 1);
+	int index = 0;
+	ObjString* key;
+	Value value;
+	for (int i = 0; tableNext(&map->table, &index, &key, &value); i++)
+	{
+		if (i > 0)
+			writeOutput(out, ", ", 2);
+		writeOutput(out, key->chars, key->length);
+		writeOutput(out, ": ", 2);
+		if (IS_MAP(value))
+			printMap(out, AS_MAP(value), &self);
+		else
+			printValue(out, value);
+	}
+	writeOutput(out, "}", 1);
+}
+
+void printObject(Output* out, Value value)
 {
 	switch (value.as.obj->type)
 	{
 		case OBJ_STRING:
-			printf("%s", AS_CSTRING(value));
+			writeOutput(out, AS_CSTRING(value), AS_STRING(value)->length);
+			break;
+		case OBJ_ARRAY:
+			printArray(out, AS_ARRAY(value));
+			break;
+		case OBJ_MAP:
+			printMap(out, AS_MAP(value), NULL);
 			break;
 	}
 }
 
-ObjString* takeString(char* chars, int length)
+ObjString* takeString(VM* vm, char* chars, int length)
 {
 	// Create slorp string from already existing heap blob of characters
 	uint32_t hash = hashString(chars, length);
-	ObjString* interned = tableFindKey(&vm.strings, chars, length, hash);
+	ObjString* interned = tableFindKey(vm, &vm->strings, chars, length, hash);
 	if (interned != NULL) 
 	{
-		FREE_ARRAY(char, chars, length + 1);
+		STAT_INC(vm, internHits);
+		PROBE_STRING_INTERN(chars, length, 1);
+		FREE_ARRAY(vm, char, chars, length + 1);
+		return interned;
 	}
-	return allocateString(chars, length, hash);
+	STAT_INC(vm, internMisses);
+	PROBE_STRING_INTERN(chars, length, 0);
+	return allocateString(vm, chars, length, hash);
 }
@@ -0,0 +1,115 @@
+#include "include/output.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+void initOutput(Output *output, int fd, size_t capacity, FlushPolicy policy)
+{
+    output->buffer = NULL;
+    output->count = 0;
+    output->capacity = capacity > 0 ? capacity : OUTPUT_DEFAULT_CAPACITY;
+    output->policy = policy;
+    output->fd = fd;
+    output->sink = NULL;
+    output->sinkContext = NULL;
+    output->failed = false;
+}
+
+void setOutputSink(Output *output, OutputSink sink, void *context)
+{
+    output->sink = sink;
+    output->sinkContext = context;
+}
+
+void freeOutput(Output *output)
+{
+    flushOutput(output);
+    free(output->buffer);
+    output->buffer = NULL;
+}
+
+static bool writeAll(int fd, const char *bytes, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t written = write(fd, bytes, length);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        bytes += written;
+        length -= written;
+    }
+    return true;
+}
+
+static bool emit(Output *output, const char *bytes, size_t length)
+{
+    if (output->failed)
+        return false;
+
+    bool written;
+    if (output->sink != NULL)
+    {
+        written = output->sink(output->sinkContext, bytes, length);
+    }
+    else
+    {
+        // Whatever stdio still holds for the same descriptor (disassembly, traces) goes first
+        if (output->fd == STDOUT_FILENO)
+            fflush(stdout);
+        written = writeAll(output->fd, bytes, length);
+    }
+    output->failed = !written;
+    return written;
+}
+
+bool flushOutput(Output *output)
+{
+    if (output->count == 0)
+        return !output->failed;
+
+    bool written = emit(output, output->buffer, output->count);
+    output->count = 0;
+    return written;
+}
+
+void writeOutput(Output *output, const char *bytes, size_t length)
+{
+    if (output->buffer == NULL)
+    {
+        output->buffer = malloc(output->capacity);
+        if (output->buffer == NULL)
+        {
+            output->failed = true;
+            return;
+        }
+    }
+
+    if (output->count + length > output->capacity)
+    {
+        flushOutput(output);
+        if (length > output->capacity)
+        {
+            // Would not fit even when empty, skip the copy
+            emit(output, bytes, length);
+            return;
+        }
+    }
+
+    memcpy(output->buffer + output->count, bytes, length);
+    output->count += length;
+}
+
+void writeOutputChar(Output *output, char c)
+{
+    if (output->buffer != NULL && output->count < output->capacity)
+        output->buffer[output->count++] = c;
+    else
+        writeOutput(output, &c, 1);
+}
@@ -0,0 +1,209 @@
+#include "include/profiler.h"
+
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "include/compiler.h"
+#include "include/vm.h"
+
+#define PROFILE_TOP_SITES 15
+#define PROFILE_INITIAL_CAPACITY 64
+
+// Signals are per process, a request makes every profiling VM report once
+static volatile sig_atomic_t reportRequested = 0;
+
+#ifdef SIGUSR1
+static void requestReport(int signal)
+{
+    (void)signal;
+    reportRequested = 1; // printed from the next allocation, printing here is not signal safe
+}
+#endif
+
+void initHeapProfiler(HeapProfiler *profiler)
+{
+    profiler->enabled = false;
+    profiler->nextKind = PROFILE_RAW;
+    profiler->sites = NULL;
+    profiler->count = 0;
+    profiler->capacity = 0;
+    profiler->totalCount = 0;
+    profiler->totalBytes = 0;
+}
+
+void enableHeapProfiler(HeapProfiler *profiler)
+{
+    profiler->enabled = true;
+#ifdef SIGUSR1
+    signal(SIGUSR1, requestReport);
+#endif
+}
+
+void freeHeapProfiler(HeapProfiler *profiler)
+{
+    // The site table uses plain malloc, going through reallocate() would profile the profiler
+    free(profiler->sites);
+    profiler->sites = NULL;
+    profiler->count = 0;
+    profiler->capacity = 0;
+}
+
+static uint32_t hashSite(int line, int kind, bool compiling)
+{
+    uint32_t hash = (uint32_t)line * 2654435761u;
+    hash ^= (uint32_t)(kind + 1) * 40503u;
+    return compiling ? ~hash : hash;
+}
+
+static AllocationSite *findSite(AllocationSite *sites, int capacity, int line, int kind, bool compiling)
+{
+    uint32_t index = hashSite(line, kind, compiling) % capacity;
+    for (;;)
+    {
+        AllocationSite *site = &sites[index];
+        if (site->count == 0 ||
+            (site->line == line && site->kind == kind && site->compiling == compiling))
+        {
+            return site;
+        }
+        index = (index + 1) % capacity;
+    }
+}
+
+static void growSites(HeapProfiler *profiler)
+{
+    int capacity = profiler->capacity == 0 ? PROFILE_INITIAL_CAPACITY : profiler->capacity * 2;
+    AllocationSite *sites = calloc(capacity, sizeof(AllocationSite));
+    if (sites == NULL)
+        exit(1);
+
+    for (int i = 0; i < profiler->capacity; i++)
+    {
+        AllocationSite *site = &profiler->sites[i];
+        if (site->count == 0)
+            continue;
+        *findSite(sites, capacity, site->line, site->kind, site->compiling) = *site;
+    }
+
+    free(profiler->sites);
+    profiler->sites = sites;
+    profiler->capacity = capacity;
+}
+
+// Source line of the allocation, from the running chunk if there is one, otherwise the compiler
+static int currentLine(VM *vm, bool *compiling)
+{
+    if (vm->chunk != NULL)
+    {
+        *compiling = false;
+        return vm->chunk->lines[currentOffset(vm)];
+    }
+
+    *compiling = true;
+    return vm->parser != NULL ? vm->parser->previous.line : 0;
+}
+
+void profileAllocation(VM *vm, size_t bytes)
+{
+    HeapProfiler *profiler = &vm->heapProfiler;
+    int kind = profiler->nextKind;
+    profiler->nextKind = PROFILE_RAW;
+
+    if (profiler->count + 1 > profiler->capacity * 3 / 4)
+        growSites(profiler);
+
+    bool compiling;
+    int line = currentLine(vm, &compiling);
+    AllocationSite *site = findSite(profiler->sites, profiler->capacity, line, kind, compiling);
+    if (site->count == 0)
+    {
+        site->line = line;
+        site->kind = kind;
+        site->compiling = compiling;
+        profiler->count++;
+    }
+    site->count++;
+    site->bytes += bytes;
+    profiler->totalCount++;
+    profiler->totalBytes += bytes;
+
+    if (reportRequested)
+    {
+        reportRequested = 0;
+        printHeapProfile(profiler, stderr);
+    }
+}
+
+static const char *kindName(int kind)
+{
+    switch (kind)
+    {
+    case OBJ_STRING:
+        return "string";
+    case OBJ_ARRAY:
+        return "array";
+    case OBJ_MAP:
+        return "map";
+    default:
+        return "raw";
+    }
+}
+
+static int compareBytes(const void *a, const void *b)
+{
+    const AllocationSite *x = a;
+    const AllocationSite *y = b;
+    return (x->bytes < y->bytes) - (x->bytes > y->bytes);
+}
+
+static int compareCount(const void *a, const void *b)
+{
+    const AllocationSite *x = a;
+    const AllocationSite *y = b;
+    return (x->count < y->count) - (x->count > y->count);
+}
+
+static void printTop(HeapProfiler *profiler, FILE *out, AllocationSite *sites, int count)
+{
+    fprintf(out, "  %-8s %-8s %-8s %12s %8s %12s %8s\n",
+            "line", "phase", "kind", "allocations", "%", "bytes", "%");
+    for (int i = 0; i < count && i < PROFILE_TOP_SITES; i++)
+    {
+        AllocationSite *site = &sites[i];
+        fprintf(out, "  %-8d %-8s %-8s %12zu %7.1f%% %12zu %7.1f%%\n",
+                site->line, site->compiling ? "compile" : "run", kindName(site->kind),
+                site->count, 100.0 * site->count / profiler->totalCount,
+                site->bytes, 100.0 * site->bytes / profiler->totalBytes);
+    }
+}
+
+void printHeapProfile(HeapProfiler *profiler, FILE *out)
+{
+    fprintf(out, "== heap profile ==\n");
+    fprintf(out, "%zu allocations, %zu bytes, %d sites\n",
+            profiler->totalCount, profiler->totalBytes, profiler->count);
+    if (profiler->count == 0)
+        return;
+
+    // Compact the used sites into a scratch array so they can be sorted both ways
+    AllocationSite *sites = malloc(sizeof(AllocationSite) * profiler->count);
+    if (sites == NULL)
+        return;
+    int count = 0;
+    for (int i = 0; i < profiler->capacity; i++)
+    {
+        if (profiler->sites[i].count != 0)
+            sites[count++] = profiler->sites[i];
+    }
+
+    qsort(sites, count, sizeof(AllocationSite), compareBytes);
+    fprintf(out, "top sites by bytes\n");
+    printTop(profiler, out, sites, count);
+
+    qsort(sites, count, sizeof(AllocationSite), compareCount);
+    fprintf(out, "top sites by count\n");
+    printTop(profiler, out, sites, count);
+
+    free(sites);
+}
@@ -0,0 +1,260 @@
+#include "include/regcode.h"
+
+#include "include/arena.h"
+#include "include/memory.h"
+#include "include/object.h"
+
+
+typedef struct
+{
+    VM *vm;
+    Arena scratch; // the operands
+    Chunk *chunk;
+    RegInstr *code; // the chunk's register code, appended to in place
+    int count;
+    int capacity;
+    int *operands; // per stack slot, the register its value is in right now
+    int producer;  // instruction that left the stack top in its own register, -1 if none did
+} Translator;
+
+static int emit(Translator *translator, RegOp op, int a, int b, int c, int offset)
+{
+    if (translator->capacity < translator->count + 1)
+    {
+        int oldCapacity = translator->capacity;
+        translator->capacity = GROW_CAPACITY(oldCapacity);
+        translator->code = GROW_ARRAY(translator->vm, RegInstr, translator->code, oldCapacity, translator->capacity);
+    }
+
+    RegInstr *instr = &translator->code[translator->count];
+    instr->op = op;
+    instr->method = 0;
+    instr->offset = offset;
+    instr->a = a;
+    instr->b = b;
+    instr->as.c = c;
+    return translator->count++;
+}
+
+static void emitGlobal(Translator *translator, RegOp op, int a, int b, Instr *instr)
+{
+    int index = emit(translator, op, a, b, 0, instr->offset);
+    translator->code[index].as.name = instr->as.name;
+}
+
+// Copies every value above `slot` that still reads the register of `slot` into its own register
+static bool movePending(Translator *translator, int slot, int top, int offset)
+{
+    bool moved = false;
+    for (int i = slot + 1; i <= top; i++)
+    {
+        if (translator->operands[i] == slot)
+        {
+            emit(translator, REG_MOVE, i, slot, 0, offset);
+            translator->operands[i] = i;
+            moved = true;
+        }
+    }
+    return moved;
+}
+
+static RegOp binaryOp(uint8_t op)
+{
+    switch (op)
+    {
+    case OP_ADD:
+        return REG_ADD;
+    case OP_SUBTRACT:
+        return REG_SUBTRACT;
+    case OP_MULTIPLY:
+        return REG_MULTIPLY;
+    case OP_DIVIDE:
+        return REG_DIVIDE;
+    case OP_EQUAL:
+        return REG_EQUAL;
+    case OP_GREATER:
+        return REG_GREATER;
+    case OP_LESS:
+        return REG_LESS;
+    case OP_ADD_NUMBER:
+        return REG_ADD_NUMBER;
+    case OP_SUBTRACT_NUMBER:
+        return REG_SUBTRACT_NUMBER;
+    case OP_MULTIPLY_NUMBER:
+        return REG_MULTIPLY_NUMBER;
+    case OP_DIVIDE_NUMBER:
+        return REG_DIVIDE_NUMBER;
+    case OP_GREATER_NUMBER:
+        return REG_GREATER_NUMBER;
+    case OP_GET_INDEX:
+        return REG_GET_INDEX;
+    case OP_MAP_CONTAINS:
+        return REG_MAP_CONTAINS;
+    case OP_MAP_DELETE:
+        return REG_MAP_DELETE;
+    default:
+        return REG_LESS_NUMBER;
+    }
+}
+
+void translateRegisters(VM *vm, Chunk *chunk)
+{
+    // A deeper stack moves every register above the slots, so the code is laid out again
+    if (chunk->registerSlots != chunk->maxStackDepth)
+    {
+        chunk->registerCodeCount = 0;
+        chunk->registerSlots = chunk->maxStackDepth;
+        chunk->translatedCount = 0;
+    }
+
+    // nil, true and false, then the constants, sit in registers above the stack slots
+    int nilRegister = chunk->registerSlots;
+    int constants = nilRegister + 3;
+
+    Translator translator;
+    translator.vm = vm;
+    initArena(&translator.scratch, vm);
+    translator.chunk = chunk;
+    translator.code = chunk->registerCode;
+    translator.count = chunk->registerCodeCount;
+    translator.capacity = chunk->registerCodeCapacity;
+    translator.operands = ARENA_ALLOCATE(&translator.scratch, int, chunk->maxStackDepth + 1);
+    translator.producer = -1;
+
+    // Records are appended in code order, the new ones are at the end
+    int resume = chunk->instructionCount;
+    while (resume > 0 && chunk->instructions[resume - 1].offset >= chunk->translatedCount)
+        resume--;
+
+    int *operands = translator.operands;
+    int depth = 0;
+    for (int i = resume; i < chunk->instructionCount; i++)
+    {
+        Instr *instr = &chunk->instructions[i];
+        int top = depth - 1;
+        int producer = -1;
+        switch (instr->op)
+        {
+        case OP_CONSTANT:
+            operands[depth++] = constants + chunk->code[instr->offset + 1];
+            break;
+        case OP_NIL:
+            operands[depth++] = nilRegister;
+            break;
+        case OP_TRUE:
+            operands[depth++] = nilRegister + 1;
+            break;
+        case OP_FALSE:
+            operands[depth++] = nilRegister + 2;
+            break;
+        case OP_POP:
+            depth--;
+            break;
+        case OP_GET_LOCAL:
+            operands[depth++] = operands[instr->as.slot];
+            break;
+        case OP_SET_LOCAL:
+        {
+            int slot = instr->as.slot;
+            if (operands[top] == slot)
+                break; // a = a
+            bool moved = movePending(&translator, slot, top, instr->offset);
+            if (!moved && translator.producer >= 0 && operands[top] == top)
+                translator.code[translator.producer].a = slot; // compute straight into the local
+            else
+                emit(&translator, REG_MOVE, slot, operands[top], 0, instr->offset);
+            operands[slot] = slot;
+            operands[top] = slot;
+            break;
+        }
+        case OP_GET_GLOBAL:
+            emitGlobal(&translator, REG_GET_GLOBAL, depth, 0, instr);
+            producer = translator.count - 1;
+            operands[depth] = depth;
+            depth++;
+            break;
+        case OP_DEFINE_GLOBAL:
+            emitGlobal(&translator, REG_DEFINE_GLOBAL, 0, operands[top], instr);
+            depth--;
+            break;
+        case OP_SET_GLOBAL:
+            emitGlobal(&translator, REG_SET_GLOBAL, 0, operands[top], instr);
+            break;
+        case OP_PRINT:
+            emit(&translator, REG_PRINT, 0, operands[top], 0, instr->offset);
+            depth--;
+            break;
+        case OP_RETURN:
+            emit(&translator, REG_RETURN, 0, 0, 0, instr->offset);
+            break;
+        case OP_NOT:
+        case OP_NEGATE:
+        case OP_NEGATE_NUMBER:
+        {
+            RegOp op = instr->op == OP_NOT ? REG_NOT : instr->op == OP_NEGATE ? REG_NEGATE : REG_NEGATE_NUMBER;
+            producer = emit(&translator, op, top, operands[top], 0, instr->offset);
+            operands[top] = top;
+            break;
+        }
+        case OP_ARRAY:
+        case OP_MAP:
+        {
+            // REG_ARRAY and REG_MAP read consecutive registers, so forwarded elements are copied into theirs
+            int first = depth - (instr->op == OP_MAP ? 2 * instr->as.count : instr->as.count);
+            for (int slot = first; slot < depth; slot++)
+            {
+                if (operands[slot] != slot)
+                {
+                    emit(&translator, REG_MOVE, slot, operands[slot], 0, instr->offset);
+                    operands[slot] = slot;
+                }
+            }
+            RegOp op = instr->op == OP_MAP ? REG_MAP : REG_ARRAY;
+            producer = emit(&translator, op, first, first, instr->as.count, instr->offset);
+            operands[first] = first;
+            depth = first + 1;
+            break;
+        }
+        case OP_SET_INDEX:
+        {
+            emit(&translator, REG_SET_INDEX, operands[top - 2], operands[top - 1], operands[top], instr->offset);
+            // The assigned value is the result. It is forwarded, unless its register is a
+            // temporary above the result's slot, which the next push may overwrite.
+            int value = operands[top];
+            if (value > top - 2 && value < nilRegister)
+            {
+                emit(&translator, REG_MOVE, top - 2, value, 0, instr->offset);
+                value = top - 2;
+            }
+            operands[top - 2] = value;
+            depth -= 2;
+            break;
+        }
+        case OP_ARRAY_UNARY:
+            producer = emit(&translator, REG_ARRAY_UNARY, top, operands[top], 0, instr->offset);
+            translator.code[producer].method = (uint8_t)instr->as.method;
+            operands[top] = top;
+            break;
+        case OP_ARRAY_BINARY:
+            producer = emit(&translator, REG_ARRAY_BINARY, top - 1, operands[top - 1], operands[top], instr->offset);
+            translator.code[producer].method = (uint8_t)instr->as.method;
+            operands[top - 1] = top - 1;
+            depth--;
+            break;
+        default: // binary operators
+            producer = emit(&translator, binaryOp(instr->op), top - 1, operands[top - 1], operands[top],
+                            instr->offset);
+            operands[top - 1] = top - 1;
+            depth--;
+            break;
+        }
+        translator.producer = producer;
+    }
+
+    freeArena(&translator.scratch);
+    chunk->registerCode = translator.code;
+    chunk->registerCodeCount = translator.count;
+    chunk->registerCodeCapacity = translator.capacity;
+    chunk->registerCount = constants + chunk->constants.count;
+    chunk->translatedCount = chunk->count;
+}
@@ -0,0 +1,246 @@
+#include "include/serialize.h"
+
+#include "include/memory.h"
+#include "include/object.h"
+#include "include/vm.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct
+{
+    uint8_t *bytes;
+    size_t count;
+    size_t capacity;
+} ByteWriter;
+
+typedef struct
+{
+    const uint8_t *bytes;
+    size_t length;
+    size_t offset;
+} ByteReader;
+
+static void writeBytes(ByteWriter *writer, const void *bytes, size_t count)
+{
+    if (writer->capacity < writer->count + count)
+    {
+        while (writer->capacity < writer->count + count)
+            writer->capacity = GROW_CAPACITY(writer->capacity);
+        writer->bytes = realloc(writer->bytes, writer->capacity);
+    }
+    memcpy(writer->bytes + writer->count, bytes, count);
+    writer->count += count;
+}
+
+static void writeU8(ByteWriter *writer, uint8_t value)
+{
+    writeBytes(writer, &value, 1);
+}
+
+static void writeU32(ByteWriter *writer, uint32_t value)
+{
+    uint8_t bytes[4] = {value, value >> 8, value >> 16, value >> 24};
+    writeBytes(writer, bytes, sizeof(bytes));
+}
+
+static void writeU64(ByteWriter *writer, uint64_t value)
+{
+    writeU32(writer, (uint32_t)value);
+    writeU32(writer, (uint32_t)(value >> 32));
+}
+
+static bool readBytes(ByteReader *reader, const uint8_t **bytes, size_t count)
+{
+    if (reader->length - reader->offset < count)
+        return false;
+    *bytes = reader->bytes + reader->offset;
+    reader->offset += count;
+    return true;
+}
+
+static bool readU8(ByteReader *reader, uint8_t *value)
+{
+    const uint8_t *bytes;
+    if (!readBytes(reader, &bytes, 1))
+        return false;
+    *value = bytes[0];
+    return true;
+}
+
+static bool readU32(ByteReader *reader, uint32_t *value)
+{
+    const uint8_t *bytes;
+    if (!readBytes(reader, &bytes, 4))
+        return false;
+    *value = bytes[0] | (uint32_t)bytes[1] << 8 | (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+    return true;
+}
+
+static bool readU64(ByteReader *reader, uint64_t *value)
+{
+    uint32_t low, high;
+    if (!readU32(reader, &low) || !readU32(reader, &high))
+        return false;
+    *value = (uint64_t)high << 32 | low;
+    return true;
+}
+
+bool isBytecode(const uint8_t *bytes, size_t length)
+{
+    return length >= BYTECODE_MAGIC_LENGTH && memcmp(bytes, BYTECODE_MAGIC, BYTECODE_MAGIC_LENGTH) == 0;
+}
+
+uint8_t *serializeChunk(Chunk *chunk, size_t *length)
+{
+    ByteWriter writer = {NULL, 0, 0};
+    writeBytes(&writer, BYTECODE_MAGIC, BYTECODE_MAGIC_LENGTH);
+    writeU8(&writer, BYTECODE_VERSION);
+
+    writeU32(&writer, chunk->constants.count);
+    for (int i = 0; i < chunk->constants.count; i++)
+    {
+        Value value = chunk->constants.values[i];
+        writeU8(&writer, value.type);
+        switch (value.type)
+        {
+        case VAL_BOOL:
+            writeU8(&writer, AS_BOOL(value));
+            break;
+        case VAL_NUMBER:
+        {
+            uint64_t bits;
+            double number = AS_NUMBER(value);
+            memcpy(&bits, &number, sizeof(bits));
+            writeU64(&writer, bits);
+            break;
+        }
+        case VAL_INT:
+            writeU64(&writer, (uint64_t)AS_INT(value));
+            break;
+        case VAL_NIL:
+            break;
+        case VAL_OBJ:
+        {
+            // The compiler only puts strings in the constant pool
+            ObjString *string = AS_STRING(value);
+            writeU32(&writer, string->length);
+            writeBytes(&writer, string->chars, string->length);
+            break;
+        }
+        }
+    }
+
+    writeU32(&writer, chunk->count);
+    writeBytes(&writer, chunk->code, chunk->count);
+    for (int i = 0; i < chunk->count; i++)
+        writeU32(&writer, (uint32_t)chunk->lines[i]);
+
+    *length = writer.count;
+    return writer.bytes;
+}
+
+static bool readConstants(VM *vm, ByteReader *reader, Chunk *chunk)
+{
+    uint32_t count;
+    if (!readU32(reader, &count) || count > UINT8_COUNT)
+        return false;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint8_t type;
+        if (!readU8(reader, &type))
+            return false;
+
+        Value value;
+        switch (type)
+        {
+        case VAL_BOOL:
+        {
+            uint8_t boolean;
+            if (!readU8(reader, &boolean))
+                return false;
+            value = BOOL_VAL(boolean != 0);
+            break;
+        }
+        case VAL_NUMBER:
+        {
+            uint64_t bits;
+            double number;
+            if (!readU64(reader, &bits))
+                return false;
+            memcpy(&number, &bits, sizeof(number));
+            value = NUMBER_VAL(number);
+            break;
+        }
+        case VAL_INT:
+        {
+            uint64_t bits;
+            if (!readU64(reader, &bits))
+                return false;
+            value = INT_VAL((int64_t)bits);
+            break;
+        }
+        case VAL_NIL:
+            value = NIL_VAL;
+            break;
+        case VAL_OBJ:
+        {
+            uint32_t length;
+            const uint8_t *chars;
+            if (!readU32(reader, &length) || length > INT32_MAX || !readBytes(reader, &chars, length))
+                return false;
+            value = OBJ_VAL(copyString(vm, (const char *)chars, (int)length));
+            break;
+        }
+        default:
+            return false;
+        }
+        addConstant(vm, chunk, value);
+    }
+    return true;
+}
+
+static bool readCode(VM *vm, ByteReader *reader, Chunk *chunk)
+{
+    uint32_t count;
+    const uint8_t *code;
+    // Every code byte is followed by its four byte line, so bound count before allocating. A chunk
+    // ends in OP_RETURN, so there is at least one byte
+    if (!readU32(reader, &count) || count == 0 || count > (reader->length - reader->offset) / 5 ||
+        !readBytes(reader, &code, count))
+        return false;
+
+    chunk->code = ALLOCATE(vm, uint8_t, count);
+    chunk->lines = ALLOCATE(vm, int, count);
+    chunk->capacity = count;
+    chunk->count = count;
+    memcpy(chunk->code, code, count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t line;
+        if (!readU32(reader, &line))
+            return false;
+        chunk->lines[i] = (int)line;
+    }
+    return true;
+}
+
+bool deserializeChunk(VM *vm, const uint8_t *bytes, size_t length, Chunk *chunk)
+{
+    ByteReader reader = {bytes, length, 0};
+    initChunk(chunk);
+
+    const uint8_t *magic;
+    uint8_t version;
+    bool valid = readBytes(&reader, &magic, BYTECODE_MAGIC_LENGTH) &&
+                 isBytecode(magic, BYTECODE_MAGIC_LENGTH) &&
+                 readU8(&reader, &version) && version == BYTECODE_VERSION &&
+                 readConstants(vm, &reader, chunk) &&
+                 readCode(vm, &reader, chunk) &&
+                 reader.offset == reader.length &&
+                 prepareChunk(vm, chunk, NULL) == NULL;
+    if (!valid)
+        freeChunk(vm, chunk);
+    return valid;
+}
@@ -0,0 +1,428 @@
+#include "include/server.h"
+
+#include "include/chunk.h"
+#include "include/compiler.h"
+#include "include/serialize.h"
+#include "include/vm.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CACHE_SIZE 64
+#define OUTPUT_BUFFER_SIZE 4096
+
+/**
+ * @brief A compiled script kept resident, so sending the same source again skips the compiler
+ * Each entry compiles into its own VM: without a GC the constants of a chunk can only be
+ * released by freeing the VM that owns them, which is what evicting an entry does.
+ */
+typedef struct
+{
+    char *source;
+    uint32_t length;
+    uint32_t hash;
+    VM *owner;
+    Chunk chunk;
+} CacheEntry;
+
+typedef struct
+{
+    CacheEntry entries[CACHE_SIZE];
+    int count;
+    int nextVictim; // round robin eviction once full
+} CompileCache;
+
+// Turns output writes into frames of one type on the client socket
+typedef struct
+{
+    int fd;
+    uint8_t type;
+} FrameStream;
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void requestStop(int signal)
+{
+    (void)signal;
+    stopRequested = 1;
+}
+
+static double nowMs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static bool writeAll(int fd, const uint8_t *bytes, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t written = write(fd, bytes, length);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        bytes += written;
+        length -= written;
+    }
+    return true;
+}
+
+static bool readAll(int fd, uint8_t *bytes, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t got = read(fd, bytes, length);
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got <= 0)
+            return false;
+        bytes += got;
+        length -= got;
+    }
+    return true;
+}
+
+static void encodeU32(uint8_t *bytes, uint32_t value)
+{
+    bytes[0] = value;
+    bytes[1] = value >> 8;
+    bytes[2] = value >> 16;
+    bytes[3] = value >> 24;
+}
+
+static uint32_t decodeU32(const uint8_t *bytes)
+{
+    return bytes[0] | (uint32_t)bytes[1] << 8 | (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+}
+
+bool writeFrame(int fd, uint8_t type, const void *payload, uint32_t length)
+{
+    uint8_t header[5];
+    header[0] = type;
+    encodeU32(header + 1, length);
+    return writeAll(fd, header, sizeof(header)) && writeAll(fd, payload, length);
+}
+
+bool readFrame(int fd, uint8_t *type, uint8_t **payload, uint32_t *length)
+{
+    uint8_t header[5];
+    if (!readAll(fd, header, sizeof(header)))
+        return false;
+
+    *type = header[0];
+    *length = decodeU32(header + 1);
+    if (*length > FRAME_MAX_PAYLOAD)
+        return false;
+
+    *payload = malloc(*length + 1); // + 1, so a source payload can be terminated in place
+    if (*payload == NULL || !readAll(fd, *payload, *length))
+    {
+        free(*payload);
+        return false;
+    }
+    return true;
+}
+
+void encodeDone(const DoneFrame *done, uint8_t bytes[16])
+{
+    encodeU32(bytes, done->result);
+    encodeU32(bytes + 4, done->cached);
+    encodeU32(bytes + 8, done->compileUs);
+    encodeU32(bytes + 12, done->runUs);
+}
+
+bool decodeDone(const uint8_t *bytes, uint32_t length, DoneFrame *done)
+{
+    if (length != 16)
+        return false;
+    done->result = decodeU32(bytes);
+    done->cached = decodeU32(bytes + 4);
+    done->compileUs = decodeU32(bytes + 8);
+    done->runUs = decodeU32(bytes + 12);
+    return true;
+}
+
+static size_t frameStreamWrite(FrameStream *stream, const char *buffer, size_t size)
+{
+    if (size > FRAME_MAX_PAYLOAD)
+        size = FRAME_MAX_PAYLOAD;
+    // A client that went away must not stop the script, its output is dropped instead
+    writeFrame(stream->fd, stream->type, buffer, (uint32_t)size);
+    return size;
+}
+
+// Output sink of a request VM, print output goes straight out as FRAME_OUTPUT
+static bool sendOutput(void *context, const char *bytes, size_t length)
+{
+    FrameStream *stream = context;
+    while (length > 0)
+    {
+        size_t sent = frameStreamWrite(stream, bytes, length);
+        bytes += sent;
+        length -= sent;
+    }
+    return true;
+}
+
+/**
+ * @brief Sends what a request wrote to `errors` as FRAME_ERROR, then empties it
+ * vm->err has to be a FILE, so errors go to a temporary file the server reuses for every
+ * request and follow the request's output, as a fully buffered stream would.
+ */
+static void sendErrors(FILE *errors, int client)
+{
+    FrameStream stream = {client, FRAME_ERROR};
+    long size = ftell(errors);
+    rewind(errors);
+    char buffer[OUTPUT_BUFFER_SIZE];
+    while (size > 0)
+    {
+        size_t count = fread(buffer, 1, size < (long)sizeof(buffer) ? (size_t)size : sizeof(buffer), errors);
+        if (count == 0)
+            break;
+        sendOutput(&stream, buffer, count);
+        size -= (long)count;
+    }
+    rewind(errors);
+}
+
+static uint32_t hashSource(const char *source, uint32_t length)
+{
+    // FNV-1a, the same function the string table uses
+    uint32_t hash = 2166136261u;
+    for (uint32_t i = 0; i < length; i++)
+    {
+        hash ^= (uint8_t)source[i];
+        hash *= 16777619;
+    }
+    return hash;
+}
+
+static void freeCacheEntry(CacheEntry *entry)
+{
+    freeChunk(entry->owner, &entry->chunk);
+    freeVM(entry->owner);
+    free(entry->owner);
+    free(entry->source);
+}
+
+static CacheEntry *findCached(CompileCache *cache, const char *source, uint32_t length, uint32_t hash)
+{
+    for (int i = 0; i < cache->count; i++)
+    {
+        CacheEntry *entry = &cache->entries[i];
+        if (entry->hash == hash && entry->length == length && memcmp(entry->source, source, length) == 0)
+            return entry;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Compiles `source` into a new cache entry
+ * @return the entry, or NULL after reporting compile errors to `err`
+ */
+static CacheEntry *compileCached(CompileCache *cache, const char *source, uint32_t length, uint32_t hash, FILE *err)
+{
+    VM *owner = malloc(sizeof(VM));
+    initVM(owner);
+    owner->err = err;
+
+    Chunk chunk;
+    initChunk(&chunk);
+    if (!compile(owner, source, &chunk))
+    {
+        freeChunk(owner, &chunk);
+        freeVM(owner);
+        free(owner);
+        return NULL;
+    }
+    owner->err = stderr; // err belongs to this request, the entry outlives it
+
+    CacheEntry *entry;
+    if (cache->count < CACHE_SIZE)
+    {
+        entry = &cache->entries[cache->count++];
+    }
+    else
+    {
+        entry = &cache->entries[cache->nextVictim];
+        cache->nextVictim = (cache->nextVictim + 1) % CACHE_SIZE;
+        freeCacheEntry(entry);
+    }
+
+    entry->source = malloc(length);
+    memcpy(entry->source, source, length);
+    entry->length = length;
+    entry->hash = hash;
+    entry->owner = owner;
+    entry->chunk = chunk;
+    return entry;
+}
+
+/**
+ * @brief Runs one request in a fresh VM and answers with its output and a FRAME_DONE
+ * @return false when the client can no longer be written to
+ */
+static bool serveRequest(CompileCache *cache, FILE *err, int client, uint8_t type, uint8_t *payload,
+                         uint32_t length)
+{
+    double start = nowMs();
+    FrameStream outStream = {client, FRAME_OUTPUT};
+
+    VM vm;
+    initVM(&vm);
+    initOutput(&vm.out, client, OUTPUT_BUFFER_SIZE, OUTPUT_FLUSH_FULL);
+    setOutputSink(&vm.out, sendOutput, &outStream);
+    vm.err = err;
+
+    DoneFrame done = {INTERPRET_OK, 0, 0, 0};
+    double compiledAt;
+    if (type == FRAME_SOURCE)
+    {
+        payload[length] = '\0';
+        uint32_t hash = hashSource((char *)payload, length);
+        CacheEntry *entry = findCached(cache, (char *)payload, length, hash);
+        done.cached = entry != NULL;
+        if (entry == NULL)
+            entry = compileCached(cache, (char *)payload, length, hash, err);
+        compiledAt = nowMs();
+
+        if (entry == NULL)
+            done.result = INTERPRET_COMPILE_ERROR;
+        else
+            done.result = runChunk(&vm, &entry->chunk);
+    }
+    else
+    {
+        Chunk chunk;
+        bool loaded = deserializeChunk(&vm, payload, length, &chunk);
+        compiledAt = nowMs();
+
+        if (!loaded)
+        {
+            fprintf(err, "Invalid bytecode.\n");
+            done.result = INTERPRET_COMPILE_ERROR;
+        }
+        else
+        {
+            done.result = runChunk(&vm, &chunk);
+            freeChunk(&vm, &chunk);
+        }
+    }
+    double ranAt = nowMs();
+
+    freeVM(&vm); // flushes the output before the errors and FRAME_DONE
+    fflush(err);
+    sendErrors(err, client);
+
+    done.compileUs = (uint32_t)((compiledAt - start) * 1000.0);
+    done.runUs = (uint32_t)((ranAt - compiledAt) * 1000.0);
+    uint8_t bytes[16];
+    encodeDone(&done, bytes);
+    bool sent = writeFrame(client, FRAME_DONE, bytes, sizeof(bytes));
+
+    fprintf(stderr, "%s %u bytes%s: result %u, compile %.3f ms, run %.3f ms, total %.3f ms\n",
+            type == FRAME_SOURCE ? "source" : "bytecode", length, done.cached ? " (cached)" : "",
+            done.result, compiledAt - start, ranAt - compiledAt, nowMs() - start);
+    return sent;
+}
+
+static void serveClient(CompileCache *cache, FILE *errors, int client)
+{
+    uint8_t type;
+    uint8_t *payload;
+    uint32_t length;
+    while (!stopRequested && readFrame(client, &type, &payload, &length))
+    {
+        bool keepGoing = (type == FRAME_SOURCE || type == FRAME_BYTECODE) &&
+                         serveRequest(cache, errors, client, type, payload, length);
+        free(payload);
+        if (!keepGoing)
+            break;
+    }
+}
+
+int runServer(const char *socketPath)
+{
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(socketPath) >= sizeof(address.sun_path))
+    {
+        fprintf(stderr, "Socket path \"%s\" is too long.\n", socketPath);
+        return 64;
+    }
+    strcpy(address.sun_path, socketPath);
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0)
+    {
+        perror("socket");
+        return 71;
+    }
+
+    // A socket left behind by a server that died is replaced, any other file is not touched
+    struct stat info;
+    if (stat(socketPath, &info) == 0 && S_ISSOCK(info.st_mode))
+        unlink(socketPath);
+    if (bind(listener, (struct sockaddr *)&address, sizeof(address)) < 0 || listen(listener, 16) < 0)
+    {
+        perror(socketPath);
+        close(listener);
+        return 71;
+    }
+
+    // No SA_RESTART, a stop signal has to interrupt the blocking accept
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = requestStop;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    FILE *errors = tmpfile();
+    if (errors == NULL)
+    {
+        perror("tmpfile");
+        close(listener);
+        unlink(socketPath);
+        return 71;
+    }
+
+    fprintf(stderr, "slorp serving on %s\n", socketPath);
+    CompileCache cache;
+    cache.count = 0;
+    cache.nextVictim = 0;
+    while (!stopRequested)
+    {
+        int client = accept(listener, NULL, NULL);
+        if (client < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("accept");
+            break;
+        }
+        serveClient(&cache, errors, client);
+        close(client);
+    }
+
+    for (int i = 0; i < cache.count; i++)
+        freeCacheEntry(&cache.entries[i]);
+    fclose(errors);
+    close(listener);
+    unlink(socketPath);
+    return 0;
+}
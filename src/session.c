@@ -0,0 +1,55 @@
+#include "include/session.h"
+
+#include "include/compiler.h"
+#include "include/scanner.h"
+
+void initSession(Session *session, VM *vm)
+{
+    session->vm = vm;
+    initChunk(&session->chunk);
+}
+
+void freeSession(Session *session)
+{
+    freeChunk(session->vm, &session->chunk);
+}
+
+// Constants `source` can add at most: every number, string and name is one, before deduplication
+static int constantBound(const char *source)
+{
+    Scanner scanner;
+    initScanner(&scanner, source);
+    int bound = 0;
+    for (Token token = scanToken(&scanner); token.type != TOKEN_EOF; token = scanToken(&scanner))
+    {
+        if (token.type == TOKEN_NUMBER || token.type == TOKEN_STRING || token.type == TOKEN_IDENTIFIER)
+            bound++;
+    }
+    return bound;
+}
+
+InterpretResult feedSession(Session *session, const char *source)
+{
+    VM *vm = session->vm;
+    Chunk *chunk = &session->chunk;
+
+    // Indices of constants are a byte. A chunk without room for the input is replaced, so an input
+    // that compiles on its own never fails for what came before it.
+    if (chunk->constants.count > 0 && chunk->constants.count + constantBound(source) > UINT8_COUNT)
+    {
+        freeChunk(vm, chunk);
+        initChunk(chunk);
+    }
+
+    int start = reopenChunk(chunk);
+    int constantCount = chunk->constants.count;
+    if (!compile(vm, source, chunk))
+    {
+        rewindChunk(chunk, start, constantCount);
+        writeChunk(vm, chunk, OP_RETURN, 0);
+        prepareChunk(vm, chunk, NULL);
+        return INTERPRET_COMPILE_ERROR;
+    }
+
+    return runChunkFrom(vm, chunk, start);
+}
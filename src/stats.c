@@ -0,0 +1,64 @@
+#include "include/stats.h"
+
+#ifdef SLORP_STATS
+
+static const char *objTypeNames[OBJ_TYPE_COUNT] = {
+    [OBJ_STRING] = "string",
+    [OBJ_ARRAY] = "array",
+    [OBJ_MAP] = "map",
+};
+
+void printStats(Stats *stats, FILE *out)
+{
+    fprintf(out, "== stats ==\n");
+    fprintf(out, "memory\n");
+    fprintf(out, "  %-22s %zu\n", "allocations", stats->allocations);
+    fprintf(out, "  %-22s %zu\n", "reallocations", stats->reallocations);
+    fprintf(out, "  %-22s %zu\n", "frees", stats->frees);
+    fprintf(out, "  %-22s %zu\n", "bytes allocated", stats->bytesAllocated);
+    fprintf(out, "  %-22s %zu\n", "bytes freed", stats->bytesFreed);
+    fprintf(out, "  %-22s %zu\n", "bytes live", stats->bytesLive);
+    fprintf(out, "  %-22s %zu\n", "bytes peak", stats->bytesPeak);
+
+    fprintf(out, "objects\n");
+    for (int type = 0; type < OBJ_TYPE_COUNT; type++)
+    {
+        fprintf(out, "  %-22s %zu (%zu bytes)\n", objTypeNames[type],
+                stats->objects[type], stats->objectBytes[type]);
+    }
+
+    size_t interns = stats->internHits + stats->internMisses;
+    fprintf(out, "interning\n");
+    fprintf(out, "  %-22s %zu\n", "hits", stats->internHits);
+    fprintf(out, "  %-22s %zu\n", "misses", stats->internMisses);
+    fprintf(out, "  %-22s %.1f%%\n", "hit rate", interns ? 100.0 * stats->internHits / interns : 0.0);
+
+    fprintf(out, "tables\n");
+    fprintf(out, "  %-22s %zu\n", "lookups", stats->tableLookups);
+    fprintf(out, "  %-22s %zu\n", "probes", stats->tableProbes);
+    fprintf(out, "  %-22s %.2f\n", "probes per lookup",
+            stats->tableLookups ? (double)stats->tableProbes / stats->tableLookups : 0.0);
+    fprintf(out, "  %-22s %zu\n", "resizes", stats->tableResizes);
+    fprintf(out, "  %-22s %zu\n", "entries rehashed", stats->tableResizeEntries);
+
+    fprintf(out, "chunks\n");
+    fprintf(out, "  %-22s %zu\n", "compiled", stats->chunksCompiled);
+    fprintf(out, "  %-22s %zu (max %zu)\n", "bytecode bytes", stats->chunkBytes, stats->chunkBytesMax);
+    fprintf(out, "  %-22s %zu (max %zu)\n", "constants", stats->chunkConstants, stats->chunkConstantsMax);
+
+    fprintf(out, "vm\n");
+    fprintf(out, "  %-22s %zu\n", "peak stack depth", stats->peakStackDepth);
+    fprintf(out, "  %-22s %zu\n", "instructions run", stats->instructionsRun);
+    fprintf(out, "  %-22s %zu\n", "column rows blocked", stats->columnRowsBlocked);
+    fprintf(out, "  %-22s %zu\n", "column rows single", stats->columnRowsSingle);
+}
+
+#else
+
+void printStats(Stats *stats, FILE *out)
+{
+    (void)stats;
+    fprintf(out, "Slorp was built without SLORP_STATS, no counters to report.\n");
+}
+
+#endif
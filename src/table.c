@@ -2,9 +2,12 @@
 #include <string.h>
 
 #include "include/memory.h"
+#include "include/vm.h"
 #include "include/object.h"
 #include "include/table.h"
 #include "include/value.h"
+#include "include/stats.h"
+#include "include/probes.h"
 
 #define TABLE_MAX_LOAD 0.75
 
@@ -15,19 +18,21 @@ void initTable(Table *table)
 	table->entries = NULL;
 }
 
-void freeTable(Table *table)
+void freeTable(VM *vm, Table *table)
 {
-	FREE_ARRAY(Entry, table->entries, table->capacity);
+	FREE_ARRAY(vm, Entry, table->entries, table->capacity);
 	initTable(table);
 }
 
-static Entry *findEntry(Entry *entries, int capacity, ObjString *key)
+static Entry *findEntry(VM *vm, Entry *entries, int capacity, ObjString *key)
 {
 	uint32_t index = key->hash % capacity;
 	Entry *tombstone = NULL;
+	STAT_INC(vm, tableLookups);
 	for (;;)
 	{
 		Entry *entry = &entries[index];
+		STAT_INC(vm, tableProbes);
 
 		if (entry->key == NULL)
 		{
@@ -51,9 +56,11 @@ static Entry *findEntry(Entry *entries, int capacity, ObjString *key)
 	}
 }
 
-static void adjustCapacity(Table *table, int capacity)
+static void adjustCapacity(VM *vm, Table *table, int capacity)
 {
-	Entry *entries = ALLOCATE(Entry, capacity);
+	Entry *entries = ALLOCATE(vm, Entry, capacity);
+	STAT_INC(vm, tableResizes);
+	PROBE_TABLE_RESIZE(table, table->capacity, capacity);
 	for (int i = 0; i < capacity; i++)
 	{
 		entries[i].key = NULL;
@@ -68,27 +75,28 @@ static void adjustCapacity(Table *table, int capacity)
 		if (entry->key == NULL)
 			continue;
 
-		Entry *dest = findEntry(entries, capacity, entry->key);
+		Entry *dest = findEntry(vm, entries, capacity, entry->key);
 		dest->key = entry->key;
 		dest->value = entry->value;
 		table->count++;
 	}
+	STAT_ADD(vm, tableResizeEntries, table->count);
 
-	FREE_ARRAY(Entry, table->entries, table->capacity); // Relaes old table
+	FREE_ARRAY(vm, Entry, table->entries, table->capacity); // Relaes old table
 
 	// Target is now our new table entries with the new capacity
 	table->entries = entries;
 	table->capacity = capacity;
 }
 
-bool tableSet(Table *table, ObjString *key, Value value)
+bool tableSet(VM *vm, Table *table, ObjString *key, Value value)
 {
 	if (table->count + 1 > table->capacity * TABLE_MAX_LOAD)
 	{
 		int capacity = GROW_CAPACITY(table->capacity);
-		adjustCapacity(table, capacity);
+		adjustCapacity(vm, table, capacity);
 	}
-	Entry *entry = findEntry(table->entries, table->capacity, key);
+	Entry *entry = findEntry(vm, table->entries, table->capacity, key);
 	bool isNewKey = entry->key == NULL;
 	if (isNewKey && IS_NIL(entry->value))
 		table->count++;
@@ -98,24 +106,49 @@ bool tableSet(Table *table, ObjString *key, Value value)
 	return isNewKey;
 }
 
-void tableAddAll(Table *from, Table *to)
+void tableReserve(VM *vm, Table *table, int count)
+{
+	int capacity = table->capacity;
+	while (count > capacity * TABLE_MAX_LOAD)
+		capacity = GROW_CAPACITY(capacity);
+	if (capacity != table->capacity)
+		adjustCapacity(vm, table, capacity);
+}
+
+bool tableNext(Table *table, int *index, ObjString **key, Value *value)
+{
+	for (; *index < table->capacity; (*index)++)
+	{
+		Entry *entry = &table->entries[*index];
+		if (entry->key != NULL)
+		{
+			*key = entry->key;
+			*value = entry->value;
+			(*index)++;
+			return true;
+		}
+	}
+	return false;
+}
+
+void tableAddAll(VM *vm, Table *from, Table *to)
 {
 	for (int i = 0; i < from->capacity; i++)
 	{
 		Entry *entry = &from->entries[i];
 		if (entry->key != NULL)
 		{
-			tableSet(to, entry->key, entry->value);
+			tableSet(vm, to, entry->key, entry->value);
 		}
 	}
 }
 
-bool tableGet(Table *table, ObjString *key, Value *value)
+bool tableGet(VM *vm, Table *table, ObjString *key, Value *value)
 {
 	if (table->count == 0)
 		return false;
 
-	Entry *entry = findEntry(table->entries, table->capacity, key);
+	Entry *entry = findEntry(vm, table->entries, table->capacity, key);
 	if (entry->key == NULL)
 		return false;
 
@@ -123,13 +156,13 @@ bool tableGet(Table *table, ObjString *key, Value *value)
 	return true;
 }
 
-bool tableDelete(Table *table, ObjString *key)
+bool tableDelete(VM *vm, Table *table, ObjString *key)
 {
 	if (table->count == 0)
 		return false;
 
 	// Find the entry to delete
-	Entry *entry = findEntry(table->entries, table->capacity, key);
+	Entry *entry = findEntry(vm, table->entries, table->capacity, key);
 	if (entry->key == NULL)
 		return false;
 
@@ -139,21 +172,24 @@ bool tableDelete(Table *table, ObjString *key)
 	return true;
 }
 
-ObjString *tableFindKey(Table *table, const char *chars, int length, uint32_t hash)
+ObjString *tableFindKey(VM *vm, Table *table, const char *chars, int length, uint32_t hash)
 {
 	if (table->count == 0)
 		return NULL;
 
 	uint32_t index = hash % table->capacity;
+	STAT_INC(vm, tableLookups);
 	for (;;)
 	{
 		Entry *entry = &table->entries[index];
+		STAT_INC(vm, tableProbes);
 		if (entry->key == NULL)
 		{
 			if (IS_NIL(entry->value))
 				return NULL;
 		}
-		else if (entry->key->length && memcmp(entry->key->chars, chars, length) == 0)
+		else if (entry->key->length == length && entry->key->hash == hash &&
+				 memcmp(entry->key->chars, chars, length) == 0)
 		{
 			return entry->key;
 		}
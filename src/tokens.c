@@ -0,0 +1,261 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "include/tokens.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// One region of the source and what its thread scanned of it
+typedef struct
+{
+    const char *source;
+    size_t start; // offset of the region, just after a newline or 0
+    size_t end;
+    Scanner scanner;
+    PackedToken *tokens;
+    size_t count;
+    size_t capacity;
+    const char **messages;
+    int messageCount;
+    int newlines;      // in [start, end), whatever they are inside of
+    bool crossed;      // the last token runs past `end`, the next region started inside it
+    size_t tokenBase;  // where the tokens go in the joined buffer
+    int lineBase;      // newlines before `start`
+    int messageBase;
+    bool valid;        // started where a serial scan has a token boundary
+    PackedToken *out;
+} LexRegion;
+
+static void pushToken(LexRegion *region, Token token)
+{
+    if (region->count == region->capacity)
+    {
+        region->capacity = region->capacity < 1024 ? 1024 : region->capacity * 2;
+        region->tokens = realloc(region->tokens, sizeof(PackedToken) * region->capacity);
+    }
+
+    PackedToken *packed = &region->tokens[region->count++];
+    packed->type = (uint8_t)token.type;
+    packed->line = token.line;
+    packed->length = (uint32_t)token.length;
+    if (token.type == TOKEN_ERROR)
+    {
+        region->messages = realloc(region->messages, sizeof(const char *) * (region->messageCount + 1));
+        region->messages[region->messageCount] = token.start;
+        packed->offset = (uint32_t)region->messageCount++;
+    }
+    else
+    {
+        packed->offset = (uint32_t)(token.start - region->source);
+    }
+}
+
+// Scans tokens starting before `until`, stops early after one that runs past it
+static void scanRegion(LexRegion *region, size_t until)
+{
+    for (;;)
+    {
+        Token token = scanToken(&region->scanner);
+        size_t at = (size_t)(region->scanner.start - region->source);
+        if (token.type == TOKEN_EOF || at >= until)
+            return;
+        pushToken(region, token);
+        if ((size_t)(region->scanner.current - region->source) > until)
+        {
+            region->crossed = true;
+            return;
+        }
+    }
+}
+
+static void copyTokens(LexRegion *region)
+{
+    for (size_t i = 0; i < region->count; i++)
+    {
+        PackedToken token = region->tokens[i];
+        token.line += region->lineBase;
+        if (token.type == TOKEN_ERROR)
+            token.offset += region->messageBase;
+        region->out[region->tokenBase + i] = token;
+    }
+}
+
+static void *lexWorker(void *argument)
+{
+    LexRegion *region = argument;
+    scanRegion(region, region->end);
+    for (const char *c = region->source + region->start;
+         (c = memchr(c, '\n', region->source + region->end - c)) != NULL; c++)
+        region->newlines++;
+    return NULL;
+}
+
+static void *copyWorker(void *argument)
+{
+    copyTokens(argument);
+    return NULL;
+}
+
+static void freeRegions(LexRegion *regions, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        free(regions[i].tokens);
+        free(regions[i].messages);
+    }
+    free(regions);
+}
+
+// Checks the cuts in order and lays out the joined buffer, once every region is scanned
+static void joinRegions(TokenBuffer *buffer, LexRegion *regions, int count, size_t length)
+{
+    size_t tokenCount = 0;
+    int lineBase = 0;
+    int messageCount = 0;
+    for (int i = 0; i < count; i++)
+    {
+        LexRegion *region = &regions[i];
+        region->valid = true;
+        if (region->crossed)
+        {
+            // A string spans the cut, this region's scanner carries on serially to the end
+            scanRegion(region, length + 1);
+            region->newlines = 0;
+            for (const char *c = region->source + region->start; (c = memchr(c, '\n', region->source + length - c)) != NULL; c++)
+                region->newlines++;
+            for (int j = i + 1; j < count; j++)
+                regions[j].valid = false;
+            count = i + 1;
+        }
+        region->tokenBase = tokenCount;
+        region->lineBase = lineBase;
+        region->messageBase = messageCount;
+        tokenCount += region->count;
+        lineBase += region->newlines;
+        messageCount += region->messageCount;
+    }
+
+    buffer->count = tokenCount + 1;
+    buffer->tokens = malloc(sizeof(PackedToken) * buffer->count);
+    buffer->messages = malloc(sizeof(const char *) * (messageCount > 0 ? messageCount : 1));
+    buffer->messageCount = messageCount;
+    for (int i = 0; i < count; i++)
+    {
+        regions[i].out = buffer->tokens;
+        if (regions[i].messageCount > 0)
+            memcpy(buffer->messages + regions[i].messageBase, regions[i].messages,
+                   sizeof(const char *) * regions[i].messageCount);
+    }
+
+    PackedToken *eof = &buffer->tokens[tokenCount];
+    eof->type = TOKEN_EOF;
+    eof->offset = (uint32_t)length;
+    eof->length = 0;
+    eof->line = lineBase + 1;
+}
+
+bool lexParallel(TokenBuffer *buffer, const char *source, int jobs)
+{
+    size_t length = strlen(source);
+    if (jobs <= 0)
+        jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (jobs < 2 || length < PARALLEL_LEX_MIN_BYTES || length >= UINT32_MAX)
+        return false;
+
+    // Cut just after the first newline past every 1/jobs of the source
+    LexRegion *regions = calloc(jobs, sizeof(LexRegion));
+    int count = 0;
+    size_t start = 0;
+    for (int i = 1; i <= jobs && start < length; i++)
+    {
+        size_t end = length;
+        if (i < jobs)
+        {
+            size_t target = length / jobs * i;
+            if (target < start)
+                target = start;
+            const char *newline = memchr(source + target, '\n', length - target);
+            end = newline != NULL ? (size_t)(newline - source) + 1 : length;
+        }
+        if (end <= start)
+            continue;
+
+        LexRegion *region = &regions[count++];
+        region->source = source;
+        region->start = start;
+        region->end = end;
+        initScanner(&region->scanner, source + start);
+        start = end;
+    }
+
+    // Region 0 is scanned by the calling thread. When a thread can't be started, the ones that
+    // were are joined and the caller scans serially, as batch mode runs on fewer threads.
+    pthread_t *threads = malloc(sizeof(pthread_t) * count);
+    for (int i = 1; i < count; i++)
+    {
+        if (pthread_create(&threads[i], NULL, lexWorker, &regions[i]) != 0)
+        {
+            for (int j = 1; j < i; j++)
+                pthread_join(threads[j], NULL);
+            freeRegions(regions, count);
+            free(threads);
+            return false;
+        }
+    }
+
+    scanRegion(&regions[0], regions[0].end);
+    for (const char *c = source; (c = memchr(c, '\n', source + regions[0].end - c)) != NULL; c++)
+        regions[0].newlines++;
+    for (int i = 1; i < count; i++)
+        pthread_join(threads[i], NULL);
+    joinRegions(buffer, regions, count, length);
+
+    // Copying in place goes wide again, a region whose thread can't be started is copied here
+    bool *started = calloc(count, sizeof(bool));
+    for (int i = 1; i < count; i++)
+    {
+        if (regions[i].valid)
+            started[i] = pthread_create(&threads[i], NULL, copyWorker, &regions[i]) == 0;
+        if (regions[i].valid && !started[i])
+            copyTokens(&regions[i]);
+    }
+    copyTokens(&regions[0]);
+    for (int i = 1; i < count; i++)
+    {
+        if (started[i])
+            pthread_join(threads[i], NULL);
+    }
+
+    freeRegions(regions, count);
+    free(started);
+    free(threads);
+
+    buffer->source = source;
+    buffer->next = 0;
+    return true;
+}
+
+void freeTokenBuffer(TokenBuffer *buffer)
+{
+    free(buffer->tokens);
+    free(buffer->messages);
+    buffer->tokens = NULL;
+    buffer->messages = NULL;
+    buffer->count = 0;
+}
+
+Token nextBufferedToken(TokenBuffer *buffer)
+{
+    PackedToken *packed = &buffer->tokens[buffer->next];
+    if (buffer->next + 1 < buffer->count)
+        buffer->next++;
+
+    Token token;
+    token.type = (TokenType)packed->type;
+    token.length = (int)packed->length;
+    token.line = packed->line;
+    token.start = packed->type == TOKEN_ERROR ? buffer->messages[packed->offset] : buffer->source + packed->offset;
+    return token;
+}
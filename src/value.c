@@ -4,6 +4,7 @@
 #include "include/memory.h"
 #include "include/value.h"
 #include "include/object.h"
+#include "include/number.h"
 
 void initValueArray(ValueArray *array)
 {
@@ -12,13 +13,13 @@ void initValueArray(ValueArray *array)
     array->count = 0;
 }
 
-void writeValueArray(ValueArray *array, Value value)
+void writeValueArray(VM *vm, ValueArray *array, Value value)
 {
     if (array->capacity < array->count + 1)
     {
         int oldCapacity = array->capacity;
         array->capacity = GROW_CAPACITY(oldCapacity);
-        array->values = GROW_ARRAY(Value, array->values,
+        array->values = GROW_ARRAY(vm, Value, array->values,
                                    oldCapacity, array->capacity);
     }
 
@@ -26,33 +27,63 @@ void writeValueArray(ValueArray *array, Value value)
     array->count++;
 }
 
-void freeValueArray(ValueArray *array)
+void freeValueArray(VM *vm, ValueArray *array)
 {
-    FREE_ARRAY(Value, array->values, array->capacity);
+    FREE_ARRAY(vm, Value, array->values, array->capacity);
     initValueArray(array);
 }
 
-void printValue(Value value)
+void printValue(Output *out, Value value)
 {
     switch (value.type)
     {
         case VAL_BOOL:
-            printf(AS_BOOL(value) ? "true" : "false");
+            if (AS_BOOL(value))
+                writeOutput(out, "true", 4);
+            else
+                writeOutput(out, "false", 5);
             break;
-        case VAL_NUMBER: printf("%g", AS_NUMBER(value)); break;
-        case VAL_NIL: printf("nil"); break;
-        case VAL_OBJ: printObject(value); break;
+        case VAL_NUMBER:
+        {
+            char number[NUMBER_BUFFER_SIZE];
+            int length = formatNumber(AS_NUMBER(value), number);
+            writeOutput(out, number, length);
+            break;
+        }
+        case VAL_INT:
+        {
+            char number[NUMBER_BUFFER_SIZE];
+            int length = formatInteger(AS_INT(value), number);
+            writeOutput(out, number, length);
+            break;
+        }
+        case VAL_NIL: writeOutput(out, "nil", 3); break;
+        case VAL_OBJ: printObject(out, value); break;
     }
 }
 
+// Exact, a double beyond 2^53 is not equal to every integer that rounds to it
+static bool intEqualsDouble(int64_t integer, double number)
+{
+    // The range test also rejects NaN, the conversion of anything outside int64 is undefined
+    return number >= -9223372036854775808.0 && number < 9223372036854775808.0 &&
+           (int64_t)number == integer && (double)(int64_t)number == number;
+}
+
 bool valuesEqual(Value a, Value b)
 {
-    if (a.type != b.type) return false;
+    if (a.type != b.type)
+    {
+        if (IS_INT(a) && IS_NUMBER(b)) return intEqualsDouble(AS_INT(a), AS_NUMBER(b));
+        if (IS_NUMBER(a) && IS_INT(b)) return intEqualsDouble(AS_INT(b), AS_NUMBER(a));
+        return false;
+    }
     switch (a.type)
     {
         case VAL_BOOL: return AS_BOOL(a) == AS_BOOL(b);
         case VAL_NIL: return true;
         case VAL_NUMBER: return AS_NUMBER(a) == AS_NUMBER(b);
+        case VAL_INT: return AS_INT(a) == AS_INT(b);
         case VAL_OBJ: return AS_OBJ(a) == AS_OBJ(b);
         default: return false; // never getting here
     }    
@@ -0,0 +1,222 @@
+#include "include/verifier.h"
+
+#include "include/array.h"
+#include "include/object.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+typedef struct
+{
+    int operands; // operand bytes after the opcode
+    int pops;     // values the instruction needs on the stack
+    int pushes;   // values it leaves in their place
+} OpShape;
+
+static const OpShape shapes[OP_COUNT] = {
+    [OP_CONSTANT] = {1, 0, 1},
+    [OP_NEGATE] = {0, 1, 1},
+    [OP_RETURN] = {0, 0, 0},
+    [OP_NIL] = {0, 0, 1},
+    [OP_TRUE] = {0, 0, 1},
+    [OP_FALSE] = {0, 0, 1},
+    [OP_NOT] = {0, 1, 1},
+    [OP_ADD] = {0, 2, 1},
+    [OP_SUBTRACT] = {0, 2, 1},
+    [OP_MULTIPLY] = {0, 2, 1},
+    [OP_DIVIDE] = {0, 2, 1},
+    [OP_EQUAL] = {0, 2, 1},
+    [OP_GREATER] = {0, 2, 1},
+    [OP_LESS] = {0, 2, 1},
+    [OP_DEFINE_GLOBAL] = {1, 1, 0},
+    [OP_GET_GLOBAL] = {1, 0, 1},
+    [OP_SET_GLOBAL] = {1, 1, 1}, // peeks the assigned value
+    [OP_GET_LOCAL] = {1, 0, 1},
+    [OP_SET_LOCAL] = {1, 1, 1},
+    [OP_PRINT] = {0, 1, 0},
+    [OP_POP] = {0, 1, 0},
+    [OP_NEGATE_NUMBER] = {0, 1, 1},
+    [OP_ADD_NUMBER] = {0, 2, 1},
+    [OP_SUBTRACT_NUMBER] = {0, 2, 1},
+    [OP_MULTIPLY_NUMBER] = {0, 2, 1},
+    [OP_DIVIDE_NUMBER] = {0, 2, 1},
+    [OP_GREATER_NUMBER] = {0, 2, 1},
+    [OP_LESS_NUMBER] = {0, 2, 1},
+    [OP_GET_LOCAL_LONG] = {2, 0, 1},
+    [OP_SET_LOCAL_LONG] = {2, 1, 1},
+    [OP_ARRAY] = {1, 0, 1}, // pops as many as its operand says
+    [OP_GET_INDEX] = {0, 2, 1},
+    [OP_SET_INDEX] = {0, 3, 1},
+    [OP_ARRAY_UNARY] = {1, 1, 1},
+    [OP_ARRAY_BINARY] = {1, 2, 1},
+    [OP_MAP] = {1, 0, 1}, // pops two per entry its operand counts
+    [OP_MAP_CONTAINS] = {0, 2, 1},
+    [OP_MAP_DELETE] = {0, 2, 1},
+};
+
+/**
+ * @brief Whether the value an instruction leaves on top is certainly a double
+ * Mirrors the compiler's type inference: the code is straight-line, so what is known about a
+ * slot after one instruction holds until the next instruction writes it. A checked operation
+ * that gets past its type test with one double operand has produced a double, the other operand
+ * was a number of either kind. Two ints can give either, so only doubles are tracked.
+ * `numbers` describes the stack before the instruction, `depth` values deep.
+ */
+static bool leavesNumber(Chunk *chunk, uint8_t instruction, int operand, const bool *numbers, int depth)
+{
+    switch (instruction)
+    {
+    case OP_CONSTANT:
+        return IS_NUMBER(chunk->constants.values[operand]);
+    case OP_GET_LOCAL:
+    case OP_GET_LOCAL_LONG:
+        return numbers[operand];
+    case OP_SET_LOCAL:
+    case OP_SET_LOCAL_LONG:
+    case OP_SET_GLOBAL:
+        return numbers[depth - 1];
+    case OP_NEGATE:
+        return numbers[depth - 1]; // an int negates to an int
+    case OP_ADD:
+    case OP_SUBTRACT:
+    case OP_MULTIPLY:
+    case OP_DIVIDE:
+        return numbers[depth - 1] || numbers[depth - 2];
+    case OP_NEGATE_NUMBER:
+    case OP_ADD_NUMBER:
+    case OP_SUBTRACT_NUMBER:
+    case OP_MULTIPLY_NUMBER:
+    case OP_DIVIDE_NUMBER:
+        return true;
+    case OP_GET_INDEX:
+        return false; // a double from an array, anything from a map
+    case OP_SET_INDEX:
+        return numbers[depth - 1]; // the assigned value, not the element it became
+    case OP_ARRAY_UNARY:
+        return operand != ARRAY_LENGTH;
+    case OP_ARRAY_BINARY:
+        return operand == ARRAY_DOT; // the others give arrays
+    default:
+        return false;
+    }
+}
+
+const char *verifyChunk(Chunk *chunk, int start, int *errorOffset)
+{
+    int depth = 0;
+    int maxDepth = start > 0 ? chunk->maxStackDepth : 0;
+    int offset = start;
+    uint8_t instruction = 0;
+    const char *error = NULL;
+    // Per stack slot, is it known to hold a number. Every instruction pushes at most one value,
+    // so the stack never gets deeper than the code is long.
+    bool *numbers = malloc(sizeof(bool) * (chunk->count - start + 1));
+
+    chunk->verified = false;
+    while (offset < chunk->count && error == NULL)
+    {
+        instruction = chunk->code[offset];
+        if (instruction >= OP_COUNT)
+        {
+            error = "Unknown opcode.";
+            break;
+        }
+
+        OpShape shape = shapes[instruction];
+        if (offset + shape.operands >= chunk->count)
+        {
+            error = "Operand past the end of the code.";
+            break;
+        }
+        int operand = shape.operands == 2   ? chunk->code[offset + 1] << 8 | chunk->code[offset + 2]
+                      : shape.operands == 1 ? chunk->code[offset + 1]
+                                            : 0;
+        int pops = instruction == OP_ARRAY ? operand : instruction == OP_MAP ? 2 * operand : shape.pops;
+        if (depth < pops)
+        {
+            error = "Stack underflow.";
+            break;
+        }
+
+        switch (instruction)
+        {
+        case OP_CONSTANT:
+            if (operand >= chunk->constants.count)
+                error = "Constant index out of range.";
+            break;
+        case OP_DEFINE_GLOBAL:
+        case OP_GET_GLOBAL:
+        case OP_SET_GLOBAL:
+            if (operand >= chunk->constants.count || !IS_STRING(chunk->constants.values[operand]))
+                error = "Global name is not a string constant.";
+            break;
+        case OP_GET_LOCAL:
+        case OP_SET_LOCAL:
+        case OP_GET_LOCAL_LONG:
+        case OP_SET_LOCAL_LONG:
+            if (operand >= depth)
+                error = "Local slot above the stack top.";
+            break;
+        case OP_NEGATE_NUMBER:
+            if (!numbers[depth - 1])
+                error = "Unchecked operand is not a proven number.";
+            break;
+        case OP_ADD_NUMBER:
+        case OP_SUBTRACT_NUMBER:
+        case OP_MULTIPLY_NUMBER:
+        case OP_DIVIDE_NUMBER:
+        case OP_GREATER_NUMBER:
+        case OP_LESS_NUMBER:
+            if (!numbers[depth - 1] || !numbers[depth - 2])
+                error = "Unchecked operand is not a proven number.";
+            break;
+        case OP_ARRAY_UNARY:
+            if (operand >= ARRAY_FIRST_BINARY)
+                error = "Unknown array method.";
+            break;
+        case OP_ARRAY_BINARY:
+            if (operand < ARRAY_FIRST_BINARY || operand >= ARRAY_METHOD_COUNT)
+                error = "Unknown array method.";
+            break;
+        default:
+            break;
+        }
+        if (error != NULL)
+            break;
+
+        if (shape.pushes > 0)
+        {
+            bool number = leavesNumber(chunk, instruction, operand, numbers, depth);
+            if (instruction == OP_SET_LOCAL || instruction == OP_SET_LOCAL_LONG)
+                numbers[operand] = number;
+            numbers[depth - pops] = number;
+        }
+        depth += shape.pushes - pops;
+        if (depth > maxDepth)
+            maxDepth = depth;
+        offset += 1 + shape.operands;
+    }
+
+    if (error == NULL && (offset == start || instruction != OP_RETURN))
+    {
+        error = "Code does not end in OP_RETURN.";
+        offset = chunk->count;
+    }
+    else if (error == NULL && depth != 0)
+    {
+        error = "Stack not empty at the final OP_RETURN.";
+        offset = chunk->count - 1;
+    }
+    free(numbers);
+    if (error != NULL)
+    {
+        if (errorOffset != NULL)
+            *errorOffset = offset;
+        return error;
+    }
+
+    chunk->maxStackDepth = maxDepth;
+    chunk->verified = true;
+    return NULL;
+}
@@ -1,57 +1,110 @@
 #include "include/vm.h"
 
+#include "include/array.h"
 #include "include/debug.h"
 #include "include/value.h"
 #include "include/compiler.h"
 #include "include/object.h"
 #include "include/memory.h"
 #include "include/table.h"
+#include "include/stats.h"
+#include "include/probes.h"
 
 #include <string.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <unistd.h>
 
-VM vm; // extern
+static void resetStack(VM *vm)
+{
+    vm->stackTop = vm->stack;
+}
 
-static void resetStack()
+/**
+ * @brief Makes room for `slots` values, doubling the stack from stackSize up to stackMax
+ * Chunks are verified, so this happens once before a run for the chunks maxStackDepth
+ * and push() itself never checks.
+ * @return false on stack overflow
+ */
+static bool reserveStack(VM *vm, int slots)
 {
-    vm.stackTop = vm.stack;
+    int capacity = (int)(vm->stackEnd - vm->stack);
+    if (slots <= capacity)
+        return true;
+    if (slots > vm->stackMax)
+        return false;
+
+    int depth = (int)(vm->stackTop - vm->stack);
+    int newCapacity = capacity == 0 ? vm->stackSize : capacity;
+    while (newCapacity < slots)
+        newCapacity *= 2;
+    if (newCapacity > vm->stackMax)
+        newCapacity = vm->stackMax;
+
+    Value *block = vm->stack != NULL ? vm->stack - STACK_GUARD : NULL;
+    block = GROW_ARRAY(vm, Value, block, capacity > 0 ? capacity + STACK_GUARD : 0, newCapacity + STACK_GUARD);
+    block[0] = NIL_VAL;
+    vm->stack = block + STACK_GUARD;
+    vm->stackTop = vm->stack + depth;
+    vm->stackEnd = vm->stack + newCapacity;
+    return true;
 }
 
-static void runtimeError(const char *format, ...)
+static void runtimeError(VM *vm, const char *format, ...)
 {
+    char message[256];
     va_list args; // variadic arguments
     va_start(args, format);
-    vprintf(format, args);
+    vsnprintf(message, sizeof(message), format, args);
     va_end(args);
-    fputs("\n", stderr); // push new line!
 
-    // Positional information
-    size_t instruction = vm.ip - vm.chunk->code - 1;
-    int line = vm.chunk->lines[instruction];
-    fprintf(stderr, "[line %d] in script\n", line);
-    resetStack();
+    flushOutput(&vm->out); // What the script printed before failing comes first
+    // Positional information, one write so reports from concurrent VMs don't interleave
+    int line = vm->chunk->lines[currentOffset(vm)];
+    fprintf(vm->err, "%s\n[line %d] in script\n", message, line);
+    PROBE_RUNTIME_ERROR(message, line);
+    resetStack(vm);
 }
 
-void initVM()
+void initVM(VM *vm)
 {
-    resetStack();
-    vm.objects = NULL;
-    initTable(&vm.strings);
-    initTable(&vm.globals);
+    vm->stack = NULL;
+    vm->stackEnd = NULL;
+    vm->stackSize = STACK_DEFAULT_SIZE;
+    vm->stackMax = STACK_DEFAULT_MAX;
+    resetStack(vm);
+    vm->chunk = NULL;
+    vm->ip = NULL;
+    vm->rip = NULL;
+    vm->backend = BACKEND_STACK;
+    vm->diagnostics = 0;
+    vm->lexJobs = 0;
+    vm->objects = NULL;
+    vm->parser = NULL;
+    initOutput(&vm->out, STDOUT_FILENO, OUTPUT_DEFAULT_CAPACITY, OUTPUT_FLUSH_FULL);
+    vm->err = stderr;
+    memset(&vm->stats, 0, sizeof(Stats));
+    initHeapProfiler(&vm->heapProfiler);
+    initTable(&vm->strings);
+    initTable(&vm->globals);
 }
 
-void freeVM()
+void freeVM(VM *vm)
 {
     // Free ALL objects
-    freeTable(&vm.strings);
-    freeTable(&vm.globals);
-    freeObjects();
+    freeTable(vm, &vm->strings);
+    freeTable(vm, &vm->globals);
+    freeObjects(vm);
+    if (vm->stack != NULL)
+        FREE_ARRAY(vm, Value, vm->stack - STACK_GUARD, vm->stackEnd - vm->stack + STACK_GUARD);
+    vm->stack = vm->stackTop = vm->stackEnd = NULL;
+    freeOutput(&vm->out);
+    freeHeapProfiler(&vm->heapProfiler);
 }
 
-static Value peek(int distance)
+static Value peek(VM *vm, int distance)
 {
-    return vm.stackTop[-1 - distance];
+    return vm->stackTop[-1 - distance];
 }
 
 static bool isFalsey(Value value)
@@ -60,213 +113,1688 @@ static bool isFalsey(Value value)
     return IS_NIL(value) || (IS_BOOL(value) && !AS_BOOL(value));
 }
 
-static void concatenate_strings()
+int currentOffset(VM *vm)
 {
-    ObjString *b = AS_STRING(pop());
-    ObjString *a = AS_STRING(pop());
+    // A column block runs the instruction records whatever the backend, and clears rip
+    if (vm->backend == BACKEND_REGISTER && vm->rip != NULL)
+        return vm->rip > vm->chunk->registerCode ? vm->rip[-1].offset : 0;
+    return vm->ip > vm->chunk->instructions ? vm->ip[-1].offset : 0;
+}
 
+static ObjString *concatenate(VM *vm, ObjString *a, ObjString *b)
+{
     int length = a->length + b->length;
-    char *chars = ALLOCATE(char, length + 1);
+    char *chars = ALLOCATE(vm, char, length + 1);
     memcpy(chars, a->chars, a->length);
     memcpy(chars + a->length, b->chars, b->length);
     chars[length] = '\0'; // Doing this means we can run this char* through functions like printf
 
-    ObjString *result = takeString(chars, length);
-    push(OBJ_VAL(result));
-}
-
-static InterpretResult run()
-{
-#define READ_BYTE() (*vm.ip++)
-#define READ_CONSTANT() (vm.chunk->constants.values[READ_BYTE()])
-#define READ_STRING() AS_STRING(READ_CONSTANT())
-#define BINARY_OP(valueType, op)                        \
-    do                                                  \
-    {                                                   \
-        if (!IS_NUMBER(peek(0)) || !IS_NUMBER(peek(1))) \
-        {                                               \
-            runtimeError("Operands must be numbers.");  \
-            return INTERPRET_RUNTIME_ERROR;             \
-        }                                               \
-        double b = AS_NUMBER(pop());                    \
-        double a = AS_NUMBER(pop());                    \
-        push(valueType(a op b));                        \
+    return takeString(vm, chars, length);
+}
+
+static void concatenate_strings(VM *vm)
+{
+    ObjString *b = AS_STRING(pop(vm));
+    ObjString *a = AS_STRING(pop(vm));
+    push(vm, OBJ_VAL(concatenate(vm, a, b)));
+}
+
+// One test for both tags instead of two branches
+#define BOTH_INT(a, b) ((((a).type ^ VAL_INT) | ((b).type ^ VAL_INT)) == 0)
+// Integers are tested first: proven doubles take the *_NUMBER opcodes, ints always come here
+#define BOTH_NUMERIC(a, b) (BOTH_INT(a, b) || (IS_NUMERIC(a) && IS_NUMERIC(b)))
+
+// AS_DOUBLE without a branch: the integer is converted either way and the result selected
+static inline double numberAsDouble(Value value)
+{
+    double converted = (double)AS_INT(value);
+    return IS_INT(value) ? converted : AS_NUMBER(value);
+}
+
+/**
+ * @brief Arithmetic on numbers of either kind, shared by every backend
+ * Two integers give an integer as long as the exact result fits in an int64, an overflow or a
+ * double operand makes the result a double. Callers have checked that both are numbers.
+ */
+static inline Value addNumbers(Value a, Value b)
+{
+    int64_t result;
+    if (BOTH_INT(a, b))
+    {
+        if (!__builtin_add_overflow(AS_INT(a), AS_INT(b), &result))
+            return INT_VAL(result);
+    }
+    return NUMBER_VAL(numberAsDouble(a) + numberAsDouble(b));
+}
+
+static inline Value subtractNumbers(Value a, Value b)
+{
+    int64_t result;
+    if (BOTH_INT(a, b))
+    {
+        if (!__builtin_sub_overflow(AS_INT(a), AS_INT(b), &result))
+            return INT_VAL(result);
+    }
+    return NUMBER_VAL(numberAsDouble(a) - numberAsDouble(b));
+}
+
+static inline Value multiplyNumbers(Value a, Value b)
+{
+    int64_t result;
+    if (BOTH_INT(a, b))
+    {
+        if (!__builtin_mul_overflow(AS_INT(a), AS_INT(b), &result))
+            return INT_VAL(result);
+    }
+    return NUMBER_VAL(numberAsDouble(a) * numberAsDouble(b));
+}
+
+// Stays an integer only when nothing is left over, 7 / 2 is 3.5 and 1 / 0 is inf as before
+static inline Value divideNumbers(Value a, Value b)
+{
+    if (BOTH_INT(a, b))
+    {
+        int64_t x = AS_INT(a), y = AS_INT(b);
+        if (y != 0 && !(x == INT64_MIN && y == -1) && x % y == 0)
+            return INT_VAL(x / y);
+    }
+    return NUMBER_VAL(numberAsDouble(a) / numberAsDouble(b));
+}
+
+static inline Value negateNumber(Value a)
+{
+    if (IS_INT(a) && AS_INT(a) != INT64_MIN)
+        return INT_VAL(-AS_INT(a));
+    return NUMBER_VAL(-numberAsDouble(a));
+}
+
+static inline Value greaterNumbers(Value a, Value b)
+{
+    if (BOTH_INT(a, b))
+        return BOOL_VAL(AS_INT(a) > AS_INT(b));
+    return BOOL_VAL(numberAsDouble(a) > numberAsDouble(b));
+}
+
+static inline Value lessNumbers(Value a, Value b)
+{
+    if (BOTH_INT(a, b))
+        return BOOL_VAL(AS_INT(a) < AS_INT(b));
+    return BOOL_VAL(numberAsDouble(a) < numberAsDouble(b));
+}
+
+/**
+ * @brief Array and map operations shared by every backend
+ * They return the message of the runtime error to report, NULL once `result` is written. Results
+ * are written only after every operand was read, so `result` may point at an operand.
+ */
+static const char *makeArray(VM *vm, const Value *elements, int count, Value *result)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (!IS_NUMERIC(elements[i]))
+            return "Array elements must be numbers.";
+    }
+    ObjArray *array = newArray(vm, count);
+    for (int i = 0; i < count; i++)
+        array->values[i] = numberAsDouble(elements[i]);
+    *result = OBJ_VAL(array);
+    return NULL;
+}
+
+// `count` entries, a key and then its value each, into a map sized for them up front
+static const char *makeMap(VM *vm, const Value *entries, int count, Value *result)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (!IS_STRING(entries[2 * i]))
+            return "Map keys must be strings.";
+    }
+    ObjMap *map = newMap(vm, count);
+    for (int i = 0; i < count; i++)
+        mapSet(vm, map, AS_STRING(entries[2 * i]), entries[2 * i + 1]);
+    *result = OBJ_VAL(map);
+    return NULL;
+}
+
+static const char *checkIndex(Value array, Value index, int *position)
+{
+    if (!IS_ARRAY(array))
+        return "Only arrays and maps can be indexed.";
+    if (!IS_INT(index))
+        return "Array index must be an integer.";
+    if (AS_INT(index) < 0 || AS_INT(index) >= AS_ARRAY(array)->count)
+        return "Array index out of bounds.";
+    *position = (int)AS_INT(index);
+    return NULL;
+}
+
+static const char *getIndex(VM *vm, Value array, Value index, Value *result)
+{
+    if (IS_MAP(array))
+    {
+        if (!IS_STRING(index))
+            return "Map keys must be strings.";
+        return tableGet(vm, &AS_MAP(array)->table, AS_STRING(index), result) ? NULL : "Map has no such key.";
+    }
+    int position;
+    const char *error = checkIndex(array, index, &position);
+    if (error == NULL)
+        *result = NUMBER_VAL(AS_ARRAY(array)->values[position]);
+    return error;
+}
+
+static const char *setIndex(VM *vm, Value array, Value index, Value value)
+{
+    if (IS_MAP(array))
+    {
+        if (!IS_STRING(index))
+            return "Map keys must be strings.";
+        mapSet(vm, AS_MAP(array), AS_STRING(index), value);
+        return NULL;
+    }
+    int position;
+    const char *error = checkIndex(array, index, &position);
+    if (error == NULL && !IS_NUMERIC(value))
+        error = "Array elements must be numbers.";
+    if (error == NULL)
+        AS_ARRAY(array)->values[position] = numberAsDouble(value);
+    return error;
+}
+
+// `argument` is only read by the methods from ARRAY_FIRST_BINARY on, maps have length() as well
+static const char *callArrayMethod(VM *vm, ArrayMethod method, Value receiver, Value argument, Value *result)
+{
+    if (IS_MAP(receiver) && method == ARRAY_LENGTH)
+    {
+        *result = INT_VAL(AS_MAP(receiver)->count);
+        return NULL;
+    }
+    if (!IS_ARRAY(receiver))
+        return "Only arrays have that method.";
+    ObjArray *array = AS_ARRAY(receiver);
+    ObjArray *other = NULL;
+    if (method == ARRAY_DOT || method == ARRAY_ADD || method == ARRAY_MUL)
+    {
+        if (!IS_ARRAY(argument))
+            return "Argument must be an array.";
+        other = AS_ARRAY(argument);
+        if (other->count != array->count)
+            return "Arrays must have the same length.";
+    }
+
+    switch (method)
+    {
+    case ARRAY_LENGTH:
+        *result = INT_VAL(array->count);
+        break;
+    case ARRAY_SUM:
+        *result = NUMBER_VAL(sumDoubles(array->values, array->count));
+        break;
+    case ARRAY_MIN:
+    case ARRAY_MAX:
+        if (array->count == 0)
+            return "Empty arrays have no min or max.";
+        *result = NUMBER_VAL(method == ARRAY_MIN ? minDoubles(array->values, array->count)
+                                                 : maxDoubles(array->values, array->count));
+        break;
+    case ARRAY_DOT:
+        *result = NUMBER_VAL(dotDoubles(array->values, other->values, array->count));
+        break;
+    case ARRAY_ADD:
+    case ARRAY_MUL:
+    {
+        ObjArray *sum = newArray(vm, array->count);
+        if (method == ARRAY_ADD)
+            addDoubles(sum->values, array->values, other->values, array->count);
+        else
+            mulDoubles(sum->values, array->values, other->values, array->count);
+        *result = OBJ_VAL(sum);
+        break;
+    }
+    case ARRAY_SCALE:
+    {
+        if (!IS_NUMERIC(argument))
+            return "Argument must be a number.";
+        ObjArray *scaled = newArray(vm, array->count);
+        scaleDoubles(scaled->values, array->values, numberAsDouble(argument), array->count);
+        *result = OBJ_VAL(scaled);
+        break;
+    }
+    }
+    return NULL;
+}
+
+// map.contains(key), or map.delete(key) when `removing`, both give whether the key was there
+static const char *callMapMethod(VM *vm, bool removing, Value receiver, Value key, Value *result)
+{
+    if (!IS_MAP(receiver))
+        return "Only maps have that method.";
+    if (!IS_STRING(key))
+        return "Map keys must be strings.";
+    ObjMap *map = AS_MAP(receiver);
+    Value value;
+    bool found = removing ? mapDelete(vm, map, AS_STRING(key)) : tableGet(vm, &map->table, AS_STRING(key), &value);
+    *result = BOOL_VAL(found);
+    return NULL;
+}
+
+// Writes the diagnostics asked for before instruction `ip`, output so far comes first
+static void traceInstruction(VM *vm)
+{
+    flushOutput(&vm->out);
+    if (vm->diagnostics & DIAG_STACK)
+        dumpStack(vm->err, vm->stack, vm->stackTop);
+    if (vm->diagnostics & DIAG_TRACE)
+        dissassembleInstruction(vm->err, vm->chunk, vm->ip->offset);
+}
+
+static void traceRegisterInstruction(VM *vm)
+{
+    flushOutput(&vm->out);
+    if (vm->diagnostics & DIAG_STACK)
+        dumpStack(vm->err, vm->stack, vm->stack + vm->chunk->maxStackDepth); // the constant registers never change
+    if (vm->diagnostics & DIAG_TRACE)
+        dissassembleRegisterInstruction(vm->err, vm->chunk, vm->rip);
+}
+
+/**
+ * @brief The dispatch loop of the stack machine
+ * Always inlined into run() and runTraced() with a constant `traced`, so the loop without
+ * tracing carries no trace check at all.
+ */
+static inline __attribute__((always_inline)) InterpretResult dispatch(VM *vm, bool traced)
+{
+#define BINARY_OP(function)                                \
+    do                                                     \
+    {                                                      \
+        if (!BOTH_NUMERIC(peek(vm, 1), peek(vm, 0)))       \
+        {                                                  \
+            runtimeError(vm, "Operands must be numbers."); \
+            return INTERPRET_RUNTIME_ERROR;                \
+        }                                                  \
+        Value b = pop(vm);                                 \
+        Value a = pop(vm);                                 \
+        push(vm, function(a, b));                          \
+    } while (false)
+// The compiler proved both operands are doubles, so no tag is tested
+#define NUMBER_OP(valueType, op)       \
+    do                                 \
+    {                                  \
+        double b = AS_NUMBER(pop(vm)); \
+        double a = AS_NUMBER(pop(vm)); \
+        push(vm, valueType(a op b));   \
+    } while (false)
+// Reports the error an array operation returned
+#define TRY(operation)                      \
+    do                                      \
+    {                                       \
+        const char *error = (operation);    \
+        if (error != NULL)                  \
+        {                                   \
+            runtimeError(vm, "%s", error);  \
+            return INTERPRET_RUNTIME_ERROR; \
+        }                                   \
     } while (false)
 
-    Value constant;
     ObjString *name = NULL;
 
     for (;;)
     {
-#ifdef DEBUG_TRACE_EXECUTION
-        printf("       ");
-        for (Value *slot = vm.stack; slot < vm.stackTop; slot++)
-        {
-            printf("[ ");
-            printValue(*slot);
-            printf(" ]");
-        }
-        printf("\n");
-        dissassembleInstruction(vm.chunk, (int)(vm.ip - vm.chunk->code));
-#endif
-        uint8_t instruction;
-        switch (instruction = READ_BYTE())
+        if (traced)
+            traceInstruction(vm);
+        Instr *instr = vm->ip++;
+        STAT_INC(vm, instructionsRun);
+        switch (instr->op)
         {
         case OP_CONSTANT:
-            constant = READ_CONSTANT();
-            push(constant);
+            push(vm, instr->as.constant); // resolved when the chunk was prepared
             break;
         case OP_NIL:
-            push(NIL_VAL);
+            push(vm, NIL_VAL);
             break;
         case OP_TRUE:
-            push(BOOL_VAL(true));
+            push(vm, BOOL_VAL(true));
             break;
         case OP_FALSE:
-            push(BOOL_VAL(false));
+            push(vm, BOOL_VAL(false));
             break;
         case OP_POP:
-            pop();
+            pop(vm);
             break;
         case OP_GET_LOCAL:
-        {
-            uint8_t slot = READ_BYTE(); // index that we saved from in the compiliation step
-            push(vm.stack[slot]);       // push the index on the stack to the top of the stack
+            push(vm, vm->stack[instr->as.slot]); // push the local's slot on the stack to the top of the stack
             break;
-            break;
-        }
         case OP_SET_LOCAL:
-        {
-            uint8_t slot = READ_BYTE();
-            vm.stack[slot] = peek(0);
+            vm->stack[instr->as.slot] = peek(vm, 0);
             break;
-        }
         case OP_GET_GLOBAL:
-            name = READ_STRING();
+            name = instr->as.name;
             Value value;
-            if (!tableGet(&vm.globals, name, &value))
+            if (!tableGet(vm, &vm->globals, name, &value))
             {
-                runtimeError("Undefined variable '%s'", name->chars);
+                runtimeError(vm, "Undefined variable '%s'", name->chars);
                 return INTERPRET_RUNTIME_ERROR;
             }
-            push(value); // Two opcodes OP_GET_GLOBAL NAME (index actually) turns into -> VALUE
+            push(vm, value); // Two opcodes OP_GET_GLOBAL NAME (index actually) turns into -> VALUE
             break;
         case OP_DEFINE_GLOBAL:
-            name = READ_STRING();
-            tableSet(&vm.globals, name, peek(0));
-            pop();
+            name = instr->as.name;
+            tableSet(vm, &vm->globals, name, peek(vm, 0));
+            pop(vm);
             break;
         case OP_PRINT:
         {
-            printValue(pop()); // The evaluated expression would have left a Value to print top of stack
-            printf("\n");
+            printValue(&vm->out, pop(vm)); // The evaluated expression would have left a Value to print top of stack
+            endOutputLine(&vm->out);
             break;
         }
         case OP_RETURN:
             // Exit interpreter
             return INTERPRET_OK;
         case OP_NEGATE:
-            if (!IS_NUMBER(peek(0)))
+            if (!IS_NUMERIC(peek(vm, 0)))
             {
-                runtimeError("Operand must be of type Number");
+                runtimeError(vm, "Operand must be of type Number");
                 return INTERPRET_RUNTIME_ERROR;
             }
             // We know that the top of stack contains a number!
-            push(NUMBER_VAL(-AS_NUMBER(pop())));
+            push(vm, negateNumber(pop(vm)));
             break; // Take the top value of the stack, negate it
         case OP_ADD:
         {
-            // Concatenation can occur between numbers AND strings
-            if (IS_STRING(peek(0)) && IS_STRING(peek(1)))
+            // Addition of numbers, or concatenation of strings
+            if (BOTH_NUMERIC(peek(vm, 1), peek(vm, 0)))
             {
-                concatenate_strings();
+                Value b = pop(vm);
+                Value a = pop(vm);
+                push(vm, addNumbers(a, b));
             }
-            else if (IS_NUMBER(peek(0)) && IS_NUMBER(peek(1)))
+            else if (IS_STRING(peek(vm, 0)) && IS_STRING(peek(vm, 1)))
             {
-                // Pop our Value's from stack & convert them to C doubles
-                double b = AS_NUMBER(pop());
-                double a = AS_NUMBER(pop());
-                // Perform C addition then convert and push back value on stack
-                push(NUMBER_VAL(a + b));
+                concatenate_strings(vm);
             }
             else
             {
-                runtimeError("Operands must be two numbers or two strings.");
+                runtimeError(vm, "Operands must be two numbers or two strings.");
                 return INTERPRET_RUNTIME_ERROR;
             }
             break;
         }
         case OP_SET_GLOBAL:
-            name = READ_STRING();
-            if (tableSet(&vm.globals, name, peek(0))) // returns false if it is a new key
+            name = instr->as.name;
+            if (tableSet(vm, &vm->globals, name, peek(vm, 0))) // returns false if it is a new key
             {
-                tableDelete(&vm.globals, name);
-                runtimeError("Can't assign to undefined variable '%s'.", name->chars);
+                tableDelete(vm, &vm->globals, name);
+                runtimeError(vm, "Can't assign to undefined variable '%s'.", name->chars);
                 return INTERPRET_RUNTIME_ERROR;
             }
             break;
         case OP_EQUAL:
         {
-            Value a = pop();
-            Value b = pop();
-            push(BOOL_VAL(valuesEqual(a, b)));
+            Value a = pop(vm);
+            Value b = pop(vm);
+            push(vm, BOOL_VAL(valuesEqual(a, b)));
             break;
         }
         case OP_GREATER:
-            BINARY_OP(BOOL_VAL, >);
+            BINARY_OP(greaterNumbers);
             break;
         case OP_LESS:
-            BINARY_OP(BOOL_VAL, <);
+            BINARY_OP(lessNumbers);
             break;
         case OP_SUBTRACT:
-            BINARY_OP(NUMBER_VAL, -);
+            BINARY_OP(subtractNumbers);
             break;
         case OP_MULTIPLY:
-            BINARY_OP(NUMBER_VAL, *);
+            BINARY_OP(multiplyNumbers);
             break;
         case OP_DIVIDE:
-            BINARY_OP(NUMBER_VAL, /);
+            BINARY_OP(divideNumbers);
             break;
         case OP_NOT:
-            push(BOOL_VAL(isFalsey(pop())));
+            push(vm, BOOL_VAL(isFalsey(pop(vm))));
+            break;
+        case OP_NEGATE_NUMBER:
+            push(vm, NUMBER_VAL(-AS_NUMBER(pop(vm))));
+            break;
+        case OP_ADD_NUMBER:
+            NUMBER_OP(NUMBER_VAL, +);
+            break;
+        case OP_SUBTRACT_NUMBER:
+            NUMBER_OP(NUMBER_VAL, -);
+            break;
+        case OP_MULTIPLY_NUMBER:
+            NUMBER_OP(NUMBER_VAL, *);
+            break;
+        case OP_DIVIDE_NUMBER:
+            NUMBER_OP(NUMBER_VAL, /);
+            break;
+        case OP_GREATER_NUMBER:
+            NUMBER_OP(BOOL_VAL, >);
+            break;
+        case OP_LESS_NUMBER:
+            NUMBER_OP(BOOL_VAL, <);
+            break;
+        case OP_ARRAY:
+        {
+            Value array;
+            TRY(makeArray(vm, vm->stackTop - instr->as.count, instr->as.count, &array));
+            vm->stackTop -= instr->as.count;
+            push(vm, array);
+            break;
+        }
+        case OP_GET_INDEX:
+        {
+            Value element;
+            TRY(getIndex(vm, peek(vm, 1), peek(vm, 0), &element));
+            vm->stackTop -= 2;
+            push(vm, element);
             break;
         }
+        case OP_SET_INDEX:
+        {
+            TRY(setIndex(vm, peek(vm, 2), peek(vm, 1), peek(vm, 0)));
+            Value value = pop(vm);
+            vm->stackTop -= 2;
+            push(vm, value);
+            break;
+        }
+        case OP_ARRAY_UNARY:
+        {
+            Value result;
+            TRY(callArrayMethod(vm, instr->as.method, peek(vm, 0), NIL_VAL, &result));
+            vm->stackTop[-1] = result;
+            break;
+        }
+        case OP_ARRAY_BINARY:
+        {
+            Value result;
+            TRY(callArrayMethod(vm, instr->as.method, peek(vm, 1), peek(vm, 0), &result));
+            vm->stackTop -= 2;
+            push(vm, result);
+            break;
+        }
+        case OP_MAP:
+        {
+            Value map;
+            TRY(makeMap(vm, vm->stackTop - 2 * instr->as.count, instr->as.count, &map));
+            vm->stackTop -= 2 * instr->as.count;
+            push(vm, map);
+            break;
+        }
+        case OP_MAP_CONTAINS:
+        case OP_MAP_DELETE:
+        {
+            Value result;
+            TRY(callMapMethod(vm, instr->op == OP_MAP_DELETE, peek(vm, 1), peek(vm, 0), &result));
+            vm->stackTop -= 2;
+            push(vm, result);
+            break;
+        }
+        }
     }
 
-#undef READ_BYTE
-#undef READ_CONSTANT
 #undef BINARY_OP
-#undef READ_STRING
+#undef NUMBER_OP
+#undef TRY
 }
 
-InterpretResult interpret(const char *source)
+static InterpretResult run(VM *vm)
 {
+    return dispatch(vm, false);
+}
+
+static InterpretResult runTraced(VM *vm)
+{
+    return dispatch(vm, true);
+}
+
+/**
+ * @brief The stack machine with its hot state in locals instead of the VM
+ * `ip` and the stack pointer `sp` live in locals, and so does `top`, the value on top of the
+ * stack: its slot in memory is stale while it is cached. A push spills the old top into its
+ * slot (at depth 0 into the guard slot below the stack), a pop reloads the new top from memory,
+ * so a binary operator reads one operand from memory and writes none. Everything is written
+ * back with SPILL() before calls that look at the VM: runtime errors and allocations read the
+ * current instruction through vm->ip, tracing reads the stack. Instruction counts are kept in a
+ * local as well and added to the stats on the way out.
+ */
+static inline __attribute__((always_inline)) InterpretResult dispatchCached(VM *vm, bool traced)
+{
+    Instr *ip = vm->ip;
+    Value *stack = vm->stack;
+    Value *sp = vm->stackTop;
+    Value top = sp[-1]; // the guard slot when the stack is empty
+    uint64_t executed = 0;
+    (void)executed; // only read by STAT_ADD
+
+#define SPILL()                                  \
+    do                                           \
+    {                                            \
+        vm->ip = ip;                             \
+        sp[-1] = top;                            \
+        vm->stackTop = sp;                       \
+        STAT_ADD(vm, instructionsRun, executed); \
+        executed = 0;                            \
+    } while (false)
+#define PUSH(value)    \
+    do                 \
+    {                  \
+        sp[-1] = top;  \
+        top = (value); \
+        sp++;          \
+    } while (false)
+#define DROP()        \
+    do                \
+    {                 \
+        sp--;         \
+        top = sp[-1]; \
+    } while (false)
+#define FAIL(...)                       \
+    do                                  \
+    {                                   \
+        SPILL();                        \
+        runtimeError(vm, __VA_ARGS__);  \
+        return INTERPRET_RUNTIME_ERROR; \
+    } while (false)
+#define BINARY_OP(function)                    \
+    do                                         \
+    {                                          \
+        Value a = sp[-2];                      \
+        if (!BOTH_NUMERIC(a, top))             \
+            FAIL("Operands must be numbers."); \
+        sp--;                                  \
+        top = function(a, top);                \
+    } while (false)
+#define NUMBER_OP(valueType, op)                              \
+    do                                                        \
+    {                                                         \
+        sp--;                                                 \
+        top = valueType(AS_NUMBER(sp[-1]) op AS_NUMBER(top)); \
+    } while (false)
+#define TRY(operation)                   \
+    do                                   \
+    {                                    \
+        const char *error = (operation); \
+        if (error != NULL)               \
+            FAIL("%s", error);           \
+    } while (false)
+
+    for (;;)
+    {
+        if (traced)
+        {
+            SPILL();
+            traceInstruction(vm);
+        }
+        Instr *instr = ip++;
+        executed++;
+        switch (instr->op)
+        {
+        case OP_CONSTANT:
+            PUSH(instr->as.constant);
+            break;
+        case OP_NIL:
+            PUSH(NIL_VAL);
+            break;
+        case OP_TRUE:
+            PUSH(BOOL_VAL(true));
+            break;
+        case OP_FALSE:
+            PUSH(BOOL_VAL(false));
+            break;
+        case OP_POP:
+            DROP();
+            break;
+        case OP_GET_LOCAL:
+            // Spilling first makes every slot current in memory, the top one included
+            sp[-1] = top;
+            top = stack[instr->as.slot];
+            sp++;
+            break;
+        case OP_SET_LOCAL:
+            stack[instr->as.slot] = top; // the top's own slot is stale anyway
+            break;
+        case OP_GET_GLOBAL:
+        {
+            Value value;
+            if (!tableGet(vm, &vm->globals, instr->as.name, &value))
+                FAIL("Undefined variable '%s'", instr->as.name->chars);
+            PUSH(value);
+            break;
+        }
+        case OP_DEFINE_GLOBAL:
+            vm->ip = ip; // a growing table is an allocation of this instruction
+            tableSet(vm, &vm->globals, instr->as.name, top);
+            DROP();
+            break;
+        case OP_SET_GLOBAL:
+            vm->ip = ip;
+            if (tableSet(vm, &vm->globals, instr->as.name, top)) // returns false if it is a new key
+            {
+                tableDelete(vm, &vm->globals, instr->as.name);
+                FAIL("Can't assign to undefined variable '%s'.", instr->as.name->chars);
+            }
+            break;
+        case OP_PRINT:
+            printValue(&vm->out, top);
+            endOutputLine(&vm->out);
+            DROP();
+            break;
+        case OP_RETURN:
+            SPILL();
+            return INTERPRET_OK;
+        case OP_NEGATE:
+            if (!IS_NUMERIC(top))
+                FAIL("Operand must be of type Number");
+            top = negateNumber(top);
+            break;
+        case OP_ADD:
+        {
+            Value a = sp[-2];
+            if (BOTH_NUMERIC(a, top))
+            {
+                sp--;
+                top = addNumbers(a, top);
+            }
+            else if (IS_STRING(a) && IS_STRING(top))
+            {
+                vm->ip = ip;
+                sp--;
+                top = OBJ_VAL(concatenate(vm, AS_STRING(a), AS_STRING(top)));
+            }
+            else
+            {
+                FAIL("Operands must be two numbers or two strings.");
+            }
+            break;
+        }
+        case OP_EQUAL:
+            sp--;
+            top = BOOL_VAL(valuesEqual(sp[-1], top));
+            break;
+        case OP_GREATER:
+            BINARY_OP(greaterNumbers);
+            break;
+        case OP_LESS:
+            BINARY_OP(lessNumbers);
+            break;
+        case OP_SUBTRACT:
+            BINARY_OP(subtractNumbers);
+            break;
+        case OP_MULTIPLY:
+            BINARY_OP(multiplyNumbers);
+            break;
+        case OP_DIVIDE:
+            BINARY_OP(divideNumbers);
+            break;
+        case OP_NOT:
+            top = BOOL_VAL(isFalsey(top));
+            break;
+        case OP_NEGATE_NUMBER:
+            top = NUMBER_VAL(-AS_NUMBER(top));
+            break;
+        case OP_ADD_NUMBER:
+            NUMBER_OP(NUMBER_VAL, +);
+            break;
+        case OP_SUBTRACT_NUMBER:
+            NUMBER_OP(NUMBER_VAL, -);
+            break;
+        case OP_MULTIPLY_NUMBER:
+            NUMBER_OP(NUMBER_VAL, *);
+            break;
+        case OP_DIVIDE_NUMBER:
+            NUMBER_OP(NUMBER_VAL, /);
+            break;
+        case OP_GREATER_NUMBER:
+            NUMBER_OP(BOOL_VAL, >);
+            break;
+        case OP_LESS_NUMBER:
+            NUMBER_OP(BOOL_VAL, <);
+            break;
+        case OP_ARRAY:
+        {
+            // The elements are read from memory, so the top goes there first
+            Value array;
+            SPILL();
+            TRY(makeArray(vm, sp - instr->as.count, instr->as.count, &array));
+            sp -= instr->as.count;
+            top = sp[-1];
+            PUSH(array);
+            break;
+        }
+        case OP_GET_INDEX:
+        {
+            Value element;
+            TRY(getIndex(vm, sp[-2], top, &element));
+            sp--;
+            top = element;
+            break;
+        }
+        case OP_SET_INDEX:
+            vm->ip = ip; // a map may grow
+            TRY(setIndex(vm, sp[-3], sp[-2], top));
+            sp -= 2; // the value stays on top
+            break;
+        case OP_ARRAY_UNARY:
+            vm->ip = ip; // some methods allocate
+            TRY(callArrayMethod(vm, instr->as.method, top, NIL_VAL, &top));
+            break;
+        case OP_ARRAY_BINARY:
+        {
+            Value result;
+            vm->ip = ip;
+            TRY(callArrayMethod(vm, instr->as.method, sp[-2], top, &result));
+            sp--;
+            top = result;
+            break;
+        }
+        case OP_MAP:
+        {
+            Value map;
+            SPILL();
+            TRY(makeMap(vm, sp - 2 * instr->as.count, instr->as.count, &map));
+            sp -= 2 * instr->as.count;
+            top = sp[-1];
+            PUSH(map);
+            break;
+        }
+        case OP_MAP_CONTAINS:
+        case OP_MAP_DELETE:
+        {
+            Value result;
+            TRY(callMapMethod(vm, instr->op == OP_MAP_DELETE, sp[-2], top, &result));
+            sp--;
+            top = result;
+            break;
+        }
+        }
+    }
+
+#undef SPILL
+#undef PUSH
+#undef DROP
+#undef FAIL
+#undef BINARY_OP
+#undef NUMBER_OP
+#undef TRY
+}
+
+static InterpretResult runCached(VM *vm)
+{
+    return dispatchCached(vm, false);
+}
+
+static InterpretResult runCachedTraced(VM *vm)
+{
+    return dispatchCached(vm, true);
+}
+
+/**
+ * @brief The register backend, runs the chunk's register code over vm->stack as register file
+ * Same semantics and errors as run(), an instruction reads its operands before writing `a`.
+ * Inlined into runRegisters() and runRegistersTraced() like dispatch().
+ */
+static inline __attribute__((always_inline)) InterpretResult dispatchRegisters(VM *vm, bool traced)
+{
+    Value *r = vm->stack;
+#define BINARY_OP(function)                                  \
+    do                                                       \
+    {                                                        \
+        if (!BOTH_NUMERIC(r[instr->b], r[instr->as.c]))      \
+        {                                                    \
+            runtimeError(vm, "Operands must be numbers.");   \
+            return INTERPRET_RUNTIME_ERROR;                  \
+        }                                                    \
+        r[instr->a] = function(r[instr->b], r[instr->as.c]); \
+    } while (false)
+#define NUMBER_OP(valueType, op) \
+    (r[instr->a] = valueType(AS_NUMBER(r[instr->b]) op AS_NUMBER(r[instr->as.c])))
+#define TRY(operation)                      \
+    do                                      \
+    {                                       \
+        const char *error = (operation);    \
+        if (error != NULL)                  \
+        {                                   \
+            runtimeError(vm, "%s", error);  \
+            return INTERPRET_RUNTIME_ERROR; \
+        }                                   \
+    } while (false)
+
+    for (;;)
+    {
+        if (traced)
+            traceRegisterInstruction(vm);
+        RegInstr *instr = vm->rip++;
+        STAT_INC(vm, instructionsRun);
+        switch (instr->op)
+        {
+        case REG_MOVE:
+            r[instr->a] = r[instr->b];
+            break;
+        case REG_NOT:
+            r[instr->a] = BOOL_VAL(isFalsey(r[instr->b]));
+            break;
+        case REG_NEGATE:
+            if (!IS_NUMERIC(r[instr->b]))
+            {
+                runtimeError(vm, "Operand must be of type Number");
+                return INTERPRET_RUNTIME_ERROR;
+            }
+            r[instr->a] = negateNumber(r[instr->b]);
+            break;
+        case REG_NEGATE_NUMBER:
+            r[instr->a] = NUMBER_VAL(-AS_NUMBER(r[instr->b]));
+            break;
+        case REG_ADD:
+        {
+            Value a = r[instr->b];
+            Value b = r[instr->as.c];
+            if (BOTH_NUMERIC(a, b))
+            {
+                r[instr->a] = addNumbers(a, b);
+            }
+            else if (IS_STRING(a) && IS_STRING(b))
+            {
+                r[instr->a] = OBJ_VAL(concatenate(vm, AS_STRING(a), AS_STRING(b)));
+            }
+            else
+            {
+                runtimeError(vm, "Operands must be two numbers or two strings.");
+                return INTERPRET_RUNTIME_ERROR;
+            }
+            break;
+        }
+        case REG_SUBTRACT:
+            BINARY_OP(subtractNumbers);
+            break;
+        case REG_MULTIPLY:
+            BINARY_OP(multiplyNumbers);
+            break;
+        case REG_DIVIDE:
+            BINARY_OP(divideNumbers);
+            break;
+        case REG_EQUAL:
+            r[instr->a] = BOOL_VAL(valuesEqual(r[instr->b], r[instr->as.c]));
+            break;
+        case REG_GREATER:
+            BINARY_OP(greaterNumbers);
+            break;
+        case REG_LESS:
+            BINARY_OP(lessNumbers);
+            break;
+        case REG_ADD_NUMBER:
+            NUMBER_OP(NUMBER_VAL, +);
+            break;
+        case REG_SUBTRACT_NUMBER:
+            NUMBER_OP(NUMBER_VAL, -);
+            break;
+        case REG_MULTIPLY_NUMBER:
+            NUMBER_OP(NUMBER_VAL, *);
+            break;
+        case REG_DIVIDE_NUMBER:
+            NUMBER_OP(NUMBER_VAL, /);
+            break;
+        case REG_GREATER_NUMBER:
+            NUMBER_OP(BOOL_VAL, >);
+            break;
+        case REG_LESS_NUMBER:
+            NUMBER_OP(BOOL_VAL, <);
+            break;
+        case REG_ARRAY:
+            TRY(makeArray(vm, &r[instr->b], instr->as.c, &r[instr->a]));
+            break;
+        case REG_GET_INDEX:
+            TRY(getIndex(vm, r[instr->b], r[instr->as.c], &r[instr->a]));
+            break;
+        case REG_SET_INDEX:
+            TRY(setIndex(vm, r[instr->a], r[instr->b], r[instr->as.c]));
+            break;
+        case REG_ARRAY_UNARY:
+            TRY(callArrayMethod(vm, instr->method, r[instr->b], NIL_VAL, &r[instr->a]));
+            break;
+        case REG_ARRAY_BINARY:
+            TRY(callArrayMethod(vm, instr->method, r[instr->b], r[instr->as.c], &r[instr->a]));
+            break;
+        case REG_MAP:
+            TRY(makeMap(vm, &r[instr->b], instr->as.c, &r[instr->a]));
+            break;
+        case REG_MAP_CONTAINS:
+        case REG_MAP_DELETE:
+            TRY(callMapMethod(vm, instr->op == REG_MAP_DELETE, r[instr->b], r[instr->as.c], &r[instr->a]));
+            break;
+        case REG_DEFINE_GLOBAL:
+            tableSet(vm, &vm->globals, instr->as.name, r[instr->b]);
+            break;
+        case REG_GET_GLOBAL:
+        {
+            ObjString *name = instr->as.name;
+            if (!tableGet(vm, &vm->globals, name, &r[instr->a]))
+            {
+                runtimeError(vm, "Undefined variable '%s'", name->chars);
+                return INTERPRET_RUNTIME_ERROR;
+            }
+            break;
+        }
+        case REG_SET_GLOBAL:
+        {
+            ObjString *name = instr->as.name;
+            if (tableSet(vm, &vm->globals, name, r[instr->b])) // returns false if it is a new key
+            {
+                tableDelete(vm, &vm->globals, name);
+                runtimeError(vm, "Can't assign to undefined variable '%s'.", name->chars);
+                return INTERPRET_RUNTIME_ERROR;
+            }
+            break;
+        }
+        case REG_PRINT:
+            printValue(&vm->out, r[instr->b]);
+            endOutputLine(&vm->out);
+            break;
+        case REG_RETURN:
+            return INTERPRET_OK;
+        }
+    }
+
+#undef BINARY_OP
+#undef NUMBER_OP
+#undef TRY
+}
+
+static InterpretResult runRegisters(VM *vm)
+{
+    return dispatchRegisters(vm, false);
+}
+
+static InterpretResult runRegistersTraced(VM *vm)
+{
+    return dispatchRegisters(vm, true);
+}
+
+// Index of the first record at or after `offset`, records are in code order
+static int findInstruction(Chunk *chunk, int offset)
+{
+    int low = 0, high = chunk->instructionCount;
+    while (low < high)
+    {
+        int middle = low + (high - low) / 2;
+        if (chunk->instructions[middle].offset < offset)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+static int findRegisterInstruction(Chunk *chunk, int offset)
+{
+    int low = 0, high = chunk->registerCodeCount;
+    while (low < high)
+    {
+        int middle = low + (high - low) / 2;
+        if (chunk->registerCode[middle].offset < offset)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+// prepareChunk, reporting bytecode that fails verification
+static bool prepare(VM *vm, Chunk *chunk)
+{
+    int offset;
+    const char *problem = prepareChunk(vm, chunk, &offset);
+    if (problem != NULL)
+        fprintf(vm->err, "Invalid bytecode: %s (offset %d)\n", problem, offset);
+    return problem == NULL;
+}
+
+// Runs `chunk` from the instruction at `start`, where the stack is empty
+static InterpretResult execute(VM *vm, Chunk *chunk, int start)
+{
+    if (!prepare(vm, chunk))
+        return INTERPRET_RUNTIME_ERROR;
+    bool registers = vm->backend == BACKEND_REGISTER;
+    int slots = registers ? chunk->registerCount : chunk->maxStackDepth;
+    if (!reserveStack(vm, slots))
+    {
+        flushOutput(&vm->out);
+        fprintf(vm->err, "Stack overflow: the script needs %d slots, the limit is %d.\n",
+                slots, vm->stackMax);
+        return INTERPRET_RUNTIME_ERROR;
+    }
+
+    vm->chunk = chunk;
+    bool traced = (vm->diagnostics & (DIAG_TRACE | DIAG_STACK)) != 0;
+    InterpretResult result;
+    if (registers)
+    {
+        // Temporaries start out nil, so a stack dump never reads garbage. Then the constant
+        // registers are loaded, see translateRegisters
+        for (int i = 0; i < chunk->registerSlots; i++)
+            vm->stack[i] = NIL_VAL;
+        Value *preloaded = vm->stack + chunk->registerSlots;
+        preloaded[0] = NIL_VAL;
+        preloaded[1] = BOOL_VAL(true);
+        preloaded[2] = BOOL_VAL(false);
+        for (int i = 0; i < chunk->constants.count; i++)
+            preloaded[3 + i] = chunk->constants.values[i];
+        vm->stackTop = vm->stack + slots;
+        STAT_MAX(vm, peakStackDepth, slots);
+
+        vm->rip = chunk->registerCode + (start > 0 ? findRegisterInstruction(chunk, start) : 0);
+        result = traced ? runRegistersTraced(vm) : runRegisters(vm);
+        resetStack(vm);
+    }
+    else if (vm->backend == BACKEND_CACHED)
+    {
+        // No push() to record the depth, the verifier knows it
+        STAT_MAX(vm, peakStackDepth, slots);
+        vm->ip = chunk->instructions + (start > 0 ? findInstruction(chunk, start) : 0);
+        result = traced ? runCachedTraced(vm) : runCached(vm);
+    }
+    else
+    {
+        vm->ip = chunk->instructions + (start > 0 ? findInstruction(chunk, start) : 0);
+        result = traced ? runTraced(vm) : run(vm);
+    }
+
+    vm->chunk = NULL; // Nothing is running, allocations from here on belong to the compiler
+    return result;
+}
+
+/**
+ * @brief Strings are compared by pointer, so strings this VM builds at runtime must intern to the
+ * chunk's own constants. Adopting them leaves them owned by the VM that compiled the chunk.
+ */
+static void adoptConstants(VM *vm, Chunk *chunk)
+{
+    for (int i = 0; i < chunk->constants.count; i++)
+    {
+        Value constant = chunk->constants.values[i];
+        if (IS_STRING(constant))
+            tableSet(vm, &vm->strings, AS_STRING(constant), NIL_VAL);
+    }
+}
+
+InterpretResult runChunk(VM *vm, Chunk *chunk)
+{
+    PROBE_INTERPRET_START("<chunk>");
+    adoptConstants(vm, chunk);
+    InterpretResult result = execute(vm, chunk, 0);
+    PROBE_INTERPRET_DONE(result);
+    return result;
+}
+
+InterpretResult runChunkFrom(VM *vm, Chunk *chunk, int offset)
+{
+    PROBE_INTERPRET_START("<chunk>");
+    InterpretResult result = execute(vm, chunk, offset);
+    PROBE_INTERPRET_DONE(result);
+    return result;
+}
+
+/*
+ * Columnar runs, see runColumns. A Column holds one value per row of the block. Doubles are kept
+ * unboxed, so arithmetic between columns of doubles is a plain loop the compiler vectorizes.
+ */
+typedef struct
+{
+    bool doubles; // the lanes are in `numbers`, all of them VAL_NUMBER, otherwise in `values`
+    double numbers[COLUMN_BLOCK];
+    Value values[COLUMN_BLOCK];
+} Column;
+
+typedef struct
+{
+    Chunk *chunk;
+    const InputColumn *inputs;
+    int inputCount;
+    ObjString **names; // the globals of the run, the inputs first
+    int nameCount;
+    int *globals; // per instruction record, the index in `names` of the global it names
+    ObjString *output;
+    Value *results;
+    int *failedRow;
+} ColumnRun;
+
+// Index of `name` in the globals of the run, -1 when it is none of them
+static int findColumnName(ColumnRun *run, ObjString *name)
+{
+    for (int i = 0; i < run->nameCount; i++)
+    {
+        if (run->names[i] == name)
+            return i;
+    }
+    return -1;
+}
+
+/**
+ * @brief Can the rows run a block at a time, and which column does each global use
+ * Rows are independent when nothing a row does is seen outside of it before the next row runs:
+ * no prints, and every global read or assigned is an input or was defined earlier in the chunk,
+ * so each row writes it before looking at it. Code is straight-line, so earlier in the
+ * instruction records is earlier in every run.
+ */
+static bool planColumns(ColumnRun *run)
+{
+    Chunk *chunk = run->chunk;
+    for (int i = 0; i < chunk->instructionCount; i++)
+    {
+        Instr *instr = &chunk->instructions[i];
+        switch (instr->op)
+        {
+        case OP_PRINT:
+            return false;
+        case OP_GET_GLOBAL:
+        case OP_SET_GLOBAL:
+            run->globals[i] = findColumnName(run, instr->as.name);
+            if (run->globals[i] < 0)
+                return false;
+            break;
+        case OP_DEFINE_GLOBAL:
+            run->globals[i] = findColumnName(run, instr->as.name);
+            if (run->globals[i] < 0)
+            {
+                run->globals[i] = run->nameCount;
+                run->names[run->nameCount++] = instr->as.name;
+            }
+            break;
+        }
+    }
+    return findColumnName(run, run->output) >= 0;
+}
+
+static inline Value laneValue(Column *column, int lane)
+{
+    return column->doubles ? NUMBER_VAL(column->numbers[lane]) : column->values[lane];
+}
+
+static void fillColumn(Column *column, Value value, int count)
+{
+    column->doubles = IS_NUMBER(value);
+    if (column->doubles)
+    {
+        for (int i = 0; i < count; i++)
+            column->numbers[i] = AS_NUMBER(value);
+    }
+    else
+    {
+        for (int i = 0; i < count; i++)
+            column->values[i] = value;
+    }
+}
+
+static void copyColumn(Column *to, Column *from, int count)
+{
+    if (to == from)
+        return;
+    to->doubles = from->doubles;
+    if (from->doubles)
+        memcpy(to->numbers, from->numbers, sizeof(double) * count);
+    else
+        memcpy(to->values, from->values, sizeof(Value) * count);
+}
+
+// Moves the lanes to `values`
+static void boxColumn(Column *column, int count)
+{
+    if (!column->doubles)
+        return;
+    for (int i = 0; i < count; i++)
+        column->values[i] = NUMBER_VAL(column->numbers[i]);
+    column->doubles = false;
+}
+
+// Is every lane a double, ints don't count
+static bool allDoubles(Column *column, int count)
+{
+    if (column->doubles)
+        return true;
+    for (int i = 0; i < count; i++)
+    {
+        if (!IS_NUMBER(column->values[i]))
+            return false;
+    }
+    return true;
+}
+
+// The lanes as doubles, boxed ones copied to `scratch`, NULL when a lane is not a number
+static const double *columnNumbers(Column *column, double *scratch, int count)
+{
+    if (column->doubles)
+        return column->numbers;
+    for (int i = 0; i < count; i++)
+    {
+        if (!IS_NUMERIC(column->values[i]))
+            return NULL;
+        scratch[i] = numberAsDouble(column->values[i]);
+    }
+    return scratch;
+}
+
+/**
+ * @brief `a = a op b` for every lane in one loop over doubles, false when the lanes don't allow it
+ * Once one operand is all doubles the scalar operators compute in doubles whatever the other
+ * number is, so its ints are converted too. Two ints keep integer semantics lane by lane, and
+ * equality between an int and a double is exact, so == only takes two columns of doubles.
+ */
+static bool binaryDoubles(uint8_t op, Column *a, Column *b, int count)
+{
+    bool aDoubles = allDoubles(a, count);
+    bool bDoubles = allDoubles(b, count);
+    if (op == OP_EQUAL ? !(aDoubles && bDoubles) : !(aDoubles || bDoubles))
+        return false;
+    double scratchA[COLUMN_BLOCK], scratchB[COLUMN_BLOCK];
+    const double *x = columnNumbers(a, scratchA, count);
+    const double *y = columnNumbers(b, scratchB, count);
+    if (x == NULL || y == NULL)
+        return false;
+
+    double *result = a->numbers;
+    switch (op)
+    {
+    case OP_ADD:
+    case OP_ADD_NUMBER:
+        for (int i = 0; i < count; i++)
+            result[i] = x[i] + y[i];
+        break;
+    case OP_SUBTRACT:
+    case OP_SUBTRACT_NUMBER:
+        for (int i = 0; i < count; i++)
+            result[i] = x[i] - y[i];
+        break;
+    case OP_MULTIPLY:
+    case OP_MULTIPLY_NUMBER:
+        for (int i = 0; i < count; i++)
+            result[i] = x[i] * y[i];
+        break;
+    case OP_DIVIDE:
+    case OP_DIVIDE_NUMBER:
+        for (int i = 0; i < count; i++)
+            result[i] = x[i] / y[i];
+        break;
+    case OP_GREATER:
+    case OP_GREATER_NUMBER:
+        for (int i = 0; i < count; i++)
+            a->values[i] = BOOL_VAL(x[i] > y[i]);
+        a->doubles = false;
+        return true;
+    case OP_LESS:
+    case OP_LESS_NUMBER:
+        for (int i = 0; i < count; i++)
+            a->values[i] = BOOL_VAL(x[i] < y[i]);
+        a->doubles = false;
+        return true;
+    case OP_EQUAL:
+        for (int i = 0; i < count; i++)
+            a->values[i] = BOOL_VAL(x[i] == y[i]);
+        a->doubles = false;
+        return true;
+    default:
+        return false;
+    }
+    a->doubles = true;
+    return true;
+}
+
+static bool negateDoubles(Column *column, int count)
+{
+    double scratch[COLUMN_BLOCK];
+    if (!allDoubles(column, count))
+        return false;
+    const double *x = columnNumbers(column, scratch, count);
+    for (int i = 0; i < count; i++)
+        column->numbers[i] = -x[i];
+    column->doubles = true;
+    return true;
+}
+
+// One lane of an instruction, on what the stack machine would have popped, false where it fails
+static bool laneOp(VM *vm, Instr *instr, const Value *args, Value *result)
+{
+    switch (instr->op)
+    {
+    case OP_NOT:
+        *result = BOOL_VAL(isFalsey(args[0]));
+        return true;
+    case OP_NEGATE:
+    case OP_NEGATE_NUMBER:
+        if (!IS_NUMERIC(args[0]))
+            return false;
+        *result = negateNumber(args[0]);
+        return true;
+    case OP_EQUAL:
+        *result = BOOL_VAL(valuesEqual(args[0], args[1]));
+        return true;
+    case OP_ADD:
+        if (IS_STRING(args[0]) && IS_STRING(args[1]))
+        {
+            *result = OBJ_VAL(concatenate(vm, AS_STRING(args[0]), AS_STRING(args[1])));
+            return true;
+        }
+        // fall through
+    case OP_ADD_NUMBER:
+    case OP_SUBTRACT:
+    case OP_SUBTRACT_NUMBER:
+    case OP_MULTIPLY:
+    case OP_MULTIPLY_NUMBER:
+    case OP_DIVIDE:
+    case OP_DIVIDE_NUMBER:
+    case OP_GREATER:
+    case OP_GREATER_NUMBER:
+    case OP_LESS:
+    case OP_LESS_NUMBER:
+        if (!BOTH_NUMERIC(args[0], args[1]))
+            return false;
+        switch (instr->op)
+        {
+        case OP_ADD:
+        case OP_ADD_NUMBER:
+            *result = addNumbers(args[0], args[1]);
+            break;
+        case OP_SUBTRACT:
+        case OP_SUBTRACT_NUMBER:
+            *result = subtractNumbers(args[0], args[1]);
+            break;
+        case OP_MULTIPLY:
+        case OP_MULTIPLY_NUMBER:
+            *result = multiplyNumbers(args[0], args[1]);
+            break;
+        case OP_DIVIDE:
+        case OP_DIVIDE_NUMBER:
+            *result = divideNumbers(args[0], args[1]);
+            break;
+        case OP_GREATER:
+        case OP_GREATER_NUMBER:
+            *result = greaterNumbers(args[0], args[1]);
+            break;
+        default:
+            *result = lessNumbers(args[0], args[1]);
+            break;
+        }
+        return true;
+    case OP_ARRAY:
+        return makeArray(vm, args, instr->as.count, result) == NULL;
+    case OP_GET_INDEX:
+        return getIndex(vm, args[0], args[1], result) == NULL;
+    case OP_SET_INDEX:
+        if (setIndex(vm, args[0], args[1], args[2]) != NULL)
+            return false;
+        *result = args[2];
+        return true;
+    case OP_ARRAY_UNARY:
+        return callArrayMethod(vm, instr->as.method, args[0], NIL_VAL, result) == NULL;
+    case OP_ARRAY_BINARY:
+        return callArrayMethod(vm, instr->as.method, args[0], args[1], result) == NULL;
+    case OP_MAP:
+        return makeMap(vm, args, instr->as.count, result) == NULL;
+    case OP_MAP_CONTAINS:
+    case OP_MAP_DELETE:
+        return callMapMethod(vm, instr->op == OP_MAP_DELETE, args[0], args[1], result) == NULL;
+    default:
+        return false;
+    }
+}
+
+// `operands[0] = instr(operands...)` one lane after the other
+static bool laneColumns(VM *vm, Instr *instr, Column *operands, int arity, int count)
+{
+    for (int k = 0; k < arity; k++)
+        boxColumn(&operands[k], count);
+    Value args[2 * MAP_MAX_LITERAL]; // the widest instruction, a map literal
+    for (int i = 0; i < count; i++)
+    {
+        for (int k = 0; k < arity; k++)
+            args[k] = operands[k].values[i];
+        if (!laneOp(vm, instr, args, &operands[0].values[i]))
+            return false;
+    }
+    operands[0].doubles = false;
+    return true;
+}
+
+/**
+ * @brief The chunk over `count` rows at once, their inputs loaded into the first `globals`
+ * The stack machine, with a column per stack slot and per global. Each instruction is dispatched
+ * once for the block, then runs as a loop over doubles where its operands allow, lane by lane
+ * through the scalar helpers where they don't.
+ * @return false when a row fails, whatever the block did is then to be thrown away
+ */
+static bool runColumnBlock(VM *vm, ColumnRun *run, Column *stack, Column *globals, int count)
+{
+    Chunk *chunk = run->chunk;
+    Column *top = stack;
+    for (Instr *instr = chunk->instructions;; instr++)
+    {
+        vm->ip = instr + 1; // allocations are attributed to the current instruction
+        int arity;
+        switch (instr->op)
+        {
+        case OP_CONSTANT:
+            fillColumn(top++, instr->as.constant, count);
+            continue;
+        case OP_NIL:
+            fillColumn(top++, NIL_VAL, count);
+            continue;
+        case OP_TRUE:
+            fillColumn(top++, BOOL_VAL(true), count);
+            continue;
+        case OP_FALSE:
+            fillColumn(top++, BOOL_VAL(false), count);
+            continue;
+        case OP_POP:
+            top--;
+            continue;
+        case OP_GET_LOCAL:
+            copyColumn(top++, &stack[instr->as.slot], count);
+            continue;
+        case OP_SET_LOCAL:
+            copyColumn(&stack[instr->as.slot], top - 1, count);
+            continue;
+        case OP_GET_GLOBAL:
+            copyColumn(top++, &globals[run->globals[instr - chunk->instructions]], count);
+            continue;
+        case OP_DEFINE_GLOBAL:
+            copyColumn(&globals[run->globals[instr - chunk->instructions]], --top, count);
+            continue;
+        case OP_SET_GLOBAL:
+            copyColumn(&globals[run->globals[instr - chunk->instructions]], top - 1, count);
+            continue;
+        case OP_RETURN:
+            // Counted once the block succeeds, the rows of a failed one are run and counted again
+            STAT_ADD(vm, instructionsRun, instr - chunk->instructions + 1);
+            return true;
+        case OP_NEGATE:
+        case OP_NEGATE_NUMBER:
+            if (negateDoubles(top - 1, count))
+                continue;
+            arity = 1;
+            break;
+        case OP_ADD:
+        case OP_SUBTRACT:
+        case OP_MULTIPLY:
+        case OP_DIVIDE:
+        case OP_EQUAL:
+        case OP_GREATER:
+        case OP_LESS:
+        case OP_ADD_NUMBER:
+        case OP_SUBTRACT_NUMBER:
+        case OP_MULTIPLY_NUMBER:
+        case OP_DIVIDE_NUMBER:
+        case OP_GREATER_NUMBER:
+        case OP_LESS_NUMBER:
+            if (binaryDoubles(instr->op, top - 2, top - 1, count))
+            {
+                top--;
+                continue;
+            }
+            arity = 2;
+            break;
+        case OP_NOT:
+        case OP_ARRAY_UNARY:
+            arity = 1;
+            break;
+        case OP_GET_INDEX:
+        case OP_ARRAY_BINARY:
+        case OP_MAP_CONTAINS:
+        case OP_MAP_DELETE:
+            arity = 2;
+            break;
+        case OP_SET_INDEX:
+            arity = 3;
+            break;
+        case OP_ARRAY:
+            arity = instr->as.count;
+            break;
+        case OP_MAP:
+            arity = 2 * instr->as.count;
+            break;
+        default:
+            return false; // OP_PRINT, planColumns keeps it out
+        }
+
+        Column *operands = top - arity;
+        if (!laneColumns(vm, instr, operands, arity, count))
+            return false;
+        top = operands + 1;
+    }
+}
+
+// The rows from `first` on, one run of the chunk each on the VM's backend
+static InterpretResult runRows(VM *vm, ColumnRun *run, int first, int count)
+{
+    for (int row = first; row < first + count; row++)
+    {
+        for (int i = 0; i < run->inputCount; i++)
+            tableSet(vm, &vm->globals, run->names[i], NUMBER_VAL(run->inputs[i].values[row]));
+        InterpretResult result = execute(vm, run->chunk, 0);
+        if (result == INTERPRET_OK && !tableGet(vm, &vm->globals, run->output, &run->results[row]))
+        {
+            flushOutput(&vm->out);
+            fprintf(vm->err, "Undefined result variable '%s'.\n", run->output->chars);
+            result = INTERPRET_RUNTIME_ERROR;
+        }
+        if (result != INTERPRET_OK)
+        {
+            *run->failedRow = row;
+            return result;
+        }
+        STAT_INC(vm, columnRowsSingle);
+    }
+    return INTERPRET_OK;
+}
+
+// The rows COLUMN_BLOCK at a time, a block where some row fails one row after the other
+static InterpretResult runBlocks(VM *vm, ColumnRun *run, int rows)
+{
+    Chunk *chunk = run->chunk;
+    int columnCount = chunk->maxStackDepth + run->nameCount;
+    Column *stack = ALLOCATE(vm, Column, columnCount);
+    Column *globals = stack + chunk->maxStackDepth;
+    Column *output = &globals[findColumnName(run, run->output)];
+
+    InterpretResult result = INTERPRET_OK;
+    bool blocked = false;
+    for (int first = 0; first < rows && result == INTERPRET_OK; first += COLUMN_BLOCK)
+    {
+        int count = rows - first < COLUMN_BLOCK ? rows - first : COLUMN_BLOCK;
+        for (int i = 0; i < run->inputCount; i++)
+        {
+            globals[i].doubles = true;
+            memcpy(globals[i].numbers, run->inputs[i].values + first, sizeof(double) * count);
+        }
+
+        Obj *mark = vm->objects;
+        vm->chunk = chunk;
+        vm->rip = NULL; // allocations are attributed by ip, see currentOffset
+        blocked = runColumnBlock(vm, run, stack, globals, count);
+        vm->chunk = NULL;
+        if (blocked)
+        {
+            for (int i = 0; i < count; i++)
+                run->results[first + i] = laneValue(output, i);
+            STAT_ADD(vm, columnRowsBlocked, count);
+        }
+        else
+        {
+            // Running the rows one by one reports the failure like any runtime error
+            freeObjectsSince(vm, mark);
+            result = runRows(vm, run, first, count);
+        }
+    }
+
+    // The globals are left as the rows one by one would leave them
+    if (blocked)
+    {
+        int last = (rows - 1) % COLUMN_BLOCK;
+        for (int i = 0; i < run->nameCount; i++)
+            tableSet(vm, &vm->globals, run->names[i], laneValue(&globals[i], last));
+    }
+    FREE_ARRAY(vm, Column, stack, columnCount);
+    return result;
+}
+
+InterpretResult runColumns(VM *vm, Chunk *chunk, const InputColumn *inputs, int inputCount, int rows,
+                           const char *output, Value *results, int *failedRow)
+{
+    *failedRow = -1;
+    adoptConstants(vm, chunk);
+    if (!prepare(vm, chunk))
+        return INTERPRET_RUNTIME_ERROR;
+
+    ColumnRun run;
+    run.chunk = chunk;
+    run.inputs = inputs;
+    run.inputCount = inputCount;
+    run.names = ALLOCATE(vm, ObjString *, inputCount + chunk->instructionCount);
+    run.nameCount = 0;
+    run.globals = ALLOCATE(vm, int, chunk->instructionCount);
+    run.output = copyString(vm, output, (int)strlen(output));
+    run.results = results;
+    run.failedRow = failedRow;
+    for (int i = 0; i < inputCount; i++)
+        run.names[run.nameCount++] = copyString(vm, inputs[i].name, (int)strlen(inputs[i].name));
+
+    // Traces show the instructions of single runs
+    bool traced = (vm->diagnostics & (DIAG_TRACE | DIAG_STACK)) != 0;
+    InterpretResult result = !traced && planColumns(&run) ? runBlocks(vm, &run, rows)
+                                                          : runRows(vm, &run, 0, rows);
+
+    FREE_ARRAY(vm, ObjString *, run.names, inputCount + chunk->instructionCount);
+    FREE_ARRAY(vm, int, run.globals, chunk->instructionCount);
+    return result;
+}
+
+InterpretResult interpret(VM *vm, const char *source)
+{
+    PROBE_INTERPRET_START(source);
     Chunk chunk;
     initChunk(&chunk);
 
-    if (!compile(source, &chunk))
+    if (!compile(vm, source, &chunk))
     {
-        freeChunk(&chunk);
+        freeChunk(vm, &chunk);
+        PROBE_INTERPRET_DONE(INTERPRET_COMPILE_ERROR);
         return INTERPRET_COMPILE_ERROR;
     }
 
-    vm.chunk = &chunk;
-    vm.ip = vm.chunk->code;
-
-    InterpretResult result = run();
-
-    freeChunk(&chunk);
+    InterpretResult result = execute(vm, &chunk, 0);
+    freeChunk(vm, &chunk);
+    PROBE_INTERPRET_DONE(result);
     return result;
 }
 
-void push(Value value)
+void push(VM *vm, Value value)
 {
-    *vm.stackTop = value;
-    vm.stackTop++;
+    *vm->stackTop = value;
+    vm->stackTop++;
+    STAT_MAX(vm, peakStackDepth, vm->stackTop - vm->stack);
 }
 
-Value pop()
+Value pop(VM *vm)
 {
-    vm.stackTop--;
-    return *vm.stackTop;
+    vm->stackTop--;
+    return *vm->stackTop;
 }